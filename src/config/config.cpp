@@ -30,12 +30,19 @@
 
 #include "config.h"
 #include "live/livequeue.h"
+#include "live/livereceiver.h"
+#include "live/pretuner.h"
+#include "live/timeshiftscheduler.h"
+
+static bool parseBool(const char* value) {
+    return !strcasecmp(value, "true") || !strcasecmp(value, "yes") || !strcmp(value, "1");
+}
 
 RoboTVServerConfig::RoboTVServerConfig() : listenPort(LISTEN_PORT) {
 }
 
 void RoboTVServerConfig::Load() {
-    LiveQueue::setTimeShiftDir(cVideoDirectory::Name());
+    TimeShiftScheduler::instance().setDirectories(cVideoDirectory::Name());
 
     if(!cConfig<cSetupLine>::Load(AddDirectory(configDirectory.c_str(), GENERAL_CONFIG_FILE), true, false)) {
         return;
@@ -52,10 +59,37 @@ void RoboTVServerConfig::Load() {
 
 bool RoboTVServerConfig::Parse(const char* Name, const char* Value) {
     if(!strcasecmp(Name, "TimeShiftDir")) {
-        LiveQueue::setTimeShiftDir(Value);
+        TimeShiftScheduler::instance().setDirectories(Value);
     }
     else if(!strcasecmp(Name, "MaxTimeShiftSize")) {
-        LiveQueue::setBufferSize(strtoull(Value, NULL, 10));
+        TimeShiftScheduler::instance().setMaxBufferSize(strtoull(Value, NULL, 10));
+    }
+    else if(!strcasecmp(Name, "TimeShiftBandwidth")) {
+        TimeShiftScheduler::instance().setBandwidth(strtoull(Value, NULL, 10));
+    }
+    else if(!strcasecmp(Name, "TimeShiftMinFree")) {
+        TimeShiftScheduler::instance().setMinFreeSpace(atoi(Value));
+    }
+    else if(!strcasecmp(Name, "TimeShiftOnDemand")) {
+        LiveQueue::setTimeShiftOnDemand(parseBool(Value));
+    }
+    else if(!strcasecmp(Name, "TimeShiftMemorySize")) {
+        LiveQueue::setMemorySize(strtoull(Value, NULL, 10));
+    }
+    else if(!strcasecmp(Name, "TimeShiftMemoryTime")) {
+        LiveQueue::setMemoryTime(atoi(Value));
+    }
+    else if(!strcasecmp(Name, "TimeShiftCompaction")) {
+        LiveQueue::setCompactionAge(atoi(Value));
+    }
+    else if(!strcasecmp(Name, "FastChannelStart")) {
+        LiveReceiver::setFastStart(parseBool(Value));
+    }
+    else if(!strcasecmp(Name, "PreTune")) {
+        PreTuner::setChannels(atoi(Value));
+    }
+    else if(!strcasecmp(Name, "PreTunePriority")) {
+        PreTuner::setPriority(atoi(Value));
     }
     else if(!strcasecmp(Name, "PiconsURL")) {
         piconsUrl = Value;
@@ -49,6 +49,11 @@ public:
 
         uint8_t* data = nullptr;
         int size = 0;
+
+        // optional malloc'ed memory area holding the payload (data points into it).
+        // a listener may take over the memory by setting buffer to nullptr.
+        uint8_t* buffer = nullptr;
+        int bufferSize = 0;
     };
 
     class Listener {
@@ -60,6 +65,16 @@ public:
 
         virtual void onStreamChange() = 0;
 
+        /**
+         * Headroom of packet buffers.
+         * Number of bytes the parsers reserve in front of the payload of
+         * StreamPacket buffers (for the header of the listener's packet).
+         * @return headroom in bytes
+         */
+        virtual int getPacketHeadroom() {
+            return 0;
+        }
+
     };
 
 private:
@@ -138,6 +153,10 @@ public:
         m_streamPosition = position;
     }
 
+    inline int getPacketHeadroom() const {
+        return m_streamer->getPacketHeadroom();
+    }
+
     /* Decoder specific data */
     void setVideoDecoderData(uint8_t* sps, size_t spsLength, uint8_t* pps, size_t ppsLength, uint8_t* vps = NULL, size_t vpsLength = 0);
 
@@ -147,6 +166,13 @@ public:
 
     uint8_t* getVideoDecoderVps(int& length);
 
+    /**
+     * Verify the decoder data.
+     * The first parsed SPS / PPS / VPS will be compared with the current
+     * (e.g. cached) decoder data. A stream change is requested if they differ.
+     */
+    void verifyVideoDecoderData();
+
     void reset();
 
     void flush();
@@ -161,6 +187,13 @@ private:
 
     int64_t m_streamPosition;
 
+    // decoder data to verify (after a fast start)
+    bool m_verifySps = false;
+
+    bool m_verifyPps = false;
+
+    bool m_verifyVps = false;
+
     Parser* createParser(StreamInfo::Type type);
 
 };
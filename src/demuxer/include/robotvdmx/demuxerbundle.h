@@ -39,16 +39,36 @@ public:
 
     void clear();
 
-    TsDemuxer* findDemuxer(int pid) const;
+    inline TsDemuxer* findDemuxer(int pid) const {
+        return m_pidTable[pid & PID_MASK];
+    }
 
     void reorderStreams(const char* lang, StreamInfo::Type type);
 
     bool isReady() const;
 
-    void updateFrom(StreamBundle* bundle);
+    /**
+     * Update the demuxers from a stream bundle.
+     * Demuxers of unchanged streams are kept (with their parser state), only
+     * demuxers of added, removed or changed streams are touched.
+     * @param bundle the new streams
+     * @return true if any demuxer has been added or removed
+     */
+    bool updateFrom(StreamBundle* bundle);
 
     bool processTsPacket(uint8_t* packet, int64_t streamPosition);
 
+    /**
+     * Process a block of TS packets.
+     * Consecutive packets of the same pid are passed to their demuxer without
+     * another lookup. All packets share the same stream position.
+     * @param buf pointer to the first TS packet
+     * @param count number of TS packets in the buffer
+     * @param streamPosition position passed through to the resulting StreamPackets
+     * @return number of packets processed by a demuxer
+     */
+    size_t processTsPackets(uint8_t* buf, size_t count, int64_t streamPosition);
+
     std::list<TsDemuxer*>::iterator begin() {
         return m_list.begin();
     }
@@ -69,8 +89,17 @@ protected:
 
 private:
 
+    void updatePidTable();
+
+    static bool isValidPayload(uint8_t* packet);
+
     std::list<TsDemuxer*> m_list;
 
+    // pid -> demuxer (13 bit pids)
+    static const int PID_MASK = 0x1FFF;
+
+    TsDemuxer* m_pidTable[PID_MASK + 1];
+
 };
 
 #endif // ROBOTV_DEMUXERBUNDLE_H
@@ -75,6 +75,12 @@ public:
 
     bool isMetaOf(const StreamInfo& rhs) const;
 
+    /**
+     * Compare the stream descriptions (as signalled in the PMT).
+     * Parsed stream information (e.g. resolution) isn't compared.
+     */
+    bool isSameStream(const StreamInfo& rhs) const;
+
     bool operator !=(const StreamInfo& rhs) const;
 
     inline int getPid() const {
@@ -109,6 +115,10 @@ public:
         return m_enabled;
     }
 
+    inline void setEnabled(bool enabled) {
+        m_enabled = enabled;
+    }
+
     void setSubtitlingDescriptor(unsigned char SubtitlingType, uint16_t CompositionPageId, uint16_t AncillaryPageId);
 
 protected:
@@ -154,7 +164,7 @@ protected:
     size_t m_ppsLength; // PPS length
     size_t m_vpsLength; // VPS length
 
-    bool m_enabled = false;
+    bool m_enabled = true; // stream selected (disabled streams won't be demuxed)
 
     friend class ChannelCache;
 
@@ -155,20 +155,48 @@ void TsDemuxer::setAudioInformation(uint8_t channels, uint32_t sampleRate, uint3
 }
 
 void TsDemuxer::setVideoDecoderData(uint8_t* sps, size_t spsLength, uint8_t* pps, size_t ppsLength, uint8_t* vps, size_t vpsLength) {
+    bool changed = false;
+
     if(sps != NULL && spsLength <= sizeof(m_sps)) {
+        if(m_verifySps) {
+            changed |= (spsLength != m_spsLength || memcmp(m_sps, sps, spsLength) != 0);
+            m_verifySps = false;
+        }
+
         m_spsLength = spsLength;
         memcpy(m_sps, sps, spsLength);
     }
 
     if(pps != NULL && ppsLength <= sizeof(m_pps)) {
+        if(m_verifyPps) {
+            changed |= (ppsLength != m_ppsLength || memcmp(m_pps, pps, ppsLength) != 0);
+            m_verifyPps = false;
+        }
+
         m_ppsLength = ppsLength;
         memcpy(m_pps, pps, ppsLength);
     }
 
     if(vps != NULL && vpsLength <= sizeof(m_vps)) {
+        if(m_verifyVps) {
+            changed |= (vpsLength != m_vpsLength || memcmp(m_vps, vps, vpsLength) != 0);
+            m_verifyVps = false;
+        }
+
         m_vpsLength = vpsLength;
         memcpy(m_vps, vps, vpsLength);
     }
+
+    // decoder data differs from the cached stream information
+    if(changed) {
+        m_streamer->onStreamChange();
+    }
+}
+
+void TsDemuxer::verifyVideoDecoderData() {
+    m_verifySps = (m_spsLength > 0);
+    m_verifyPps = (m_ppsLength > 0);
+    m_verifyVps = (m_vpsLength > 0);
 }
 
 uint8_t* TsDemuxer::getVideoDecoderSps(int& length) {
@@ -29,6 +29,7 @@
 #include "robotvdmx/pes.h"
 
 DemuxerBundle::DemuxerBundle(TsDemuxer::Listener* listener) : m_listener(listener) {
+    updatePidTable();
 }
 
 DemuxerBundle::~DemuxerBundle() {
@@ -42,16 +43,17 @@ void DemuxerBundle::clear() {
     }
 
     m_list.clear();
+    updatePidTable();
 }
 
-TsDemuxer* DemuxerBundle::findDemuxer(int Pid) const {
+void DemuxerBundle::updatePidTable() {
+    memset(m_pidTable, 0, sizeof(m_pidTable));
+
     for (auto i : m_list) {
-        if(i != nullptr && i->getPid() == Pid) {
-            return i;
+        if(i != nullptr) {
+            m_pidTable[i->getPid() & PID_MASK] = i;
         }
     }
-
-    return nullptr;
 }
 
 void DemuxerBundle::reorderStreams(const char* lang, StreamInfo::Type type) {
@@ -81,10 +83,10 @@ void DemuxerBundle::reorderStreams(const char* lang, StreamInfo::Type type) {
 #define LANGUAGE_MASK   0x00200000
 #define STREAMTYPE_MASK 0x00100000
 #define CHANNEL_MASK    0x000F0000
-#define PID_MASK        0x0000FFFF
+#define REORDER_PID_MASK 0x0000FFFF
 
         // last resort ordering, the PID
-        uint32_t w = 0xFFFF - ((uint32_t)stream->getPid() & PID_MASK);
+        uint32_t w = 0xFFFF - ((uint32_t)stream->getPid() & REORDER_PID_MASK);
 
         uint8_t channels = 0;
 
@@ -145,7 +147,7 @@ bool DemuxerBundle::isReady() const {
     }
 
     for (auto i : m_list) {
-        if(!i->isParsed()) {
+        if(i->isEnabled() && !i->isParsed()) {
             return false;
         }
     }
@@ -153,17 +155,40 @@ bool DemuxerBundle::isReady() const {
     return true;
 }
 
-void DemuxerBundle::updateFrom(StreamBundle* bundle) {
-    // remove old demuxers
-    clear();
+bool DemuxerBundle::updateFrom(StreamBundle* bundle) {
+    bool changed = false;
+    std::list<TsDemuxer*> list;
+
+    // keep demuxers of unchanged streams
+    for (auto dmx : m_list) {
+        auto i = bundle->find(dmx->getPid());
+
+        if(i != bundle->end() && dmx->isSameStream(i->second)) {
+            list.push_back(dmx);
+            continue;
+        }
+
+        delete dmx;
+        changed = true;
+    }
 
-    // create new stream demuxers
+    m_list = list;
+    updatePidTable();
+
+    // create demuxers for new streams
     for (auto &i : *bundle) {
         StreamInfo& info = i.second;
-        auto dmx = new TsDemuxer(m_listener, info);
 
-        m_list.push_back(dmx);
+        if(findDemuxer(info.getPid()) != nullptr) {
+            continue;
+        }
+
+        m_list.push_back(new TsDemuxer(m_listener, info));
+        changed = true;
     }
+
+    updatePidTable();
+    return changed;
 }
 
 bool DemuxerBundle::processTsPacket(uint8_t* packet, int64_t streamPosition) {
@@ -171,18 +196,60 @@ bool DemuxerBundle::processTsPacket(uint8_t* packet, int64_t streamPosition) {
         return false;
     }
 
-    if(TsIsScrambled(packet)) {
+    TsDemuxer* demuxer = findDemuxer(TsPid(packet));
+
+    if(demuxer == nullptr || !demuxer->isEnabled() || !isValidPayload(packet)) {
         return false;
     }
 
-    if(!TsHasPayload(packet)) {
-        return false;
+    demuxer->setStreamPosition(streamPosition);
+    return demuxer->processTsPacket(packet);
+}
+
+size_t DemuxerBundle::processTsPackets(uint8_t* buf, size_t count, int64_t streamPosition) {
+    size_t processed = 0;
+    int lastPid = -1;
+    TsDemuxer* demuxer = nullptr;
+
+    for(size_t i = 0; i < count; i++, buf += TS_SIZE) {
+        if(*buf != 0x47) {
+            continue;
+        }
+
+        // consecutive packets of the same pid go to the same demuxer
+        int pid = TsPid(buf);
+
+        if(pid != lastPid) {
+            lastPid = pid;
+            demuxer = findDemuxer(pid);
+
+            if(demuxer != nullptr && !demuxer->isEnabled()) {
+                demuxer = nullptr;
+            }
+
+            if(demuxer != nullptr) {
+                demuxer->setStreamPosition(streamPosition);
+            }
+        }
+
+        if(demuxer == nullptr || !isValidPayload(buf)) {
+            continue;
+        }
+
+        if(demuxer->processTsPacket(buf)) {
+            processed++;
+        }
     }
 
-    int pid = TsPid(packet);
-    TsDemuxer* demuxer = findDemuxer(pid);
+    return processed;
+}
 
-    if(demuxer == nullptr) {
+bool DemuxerBundle::isValidPayload(uint8_t* packet) {
+    if(TsIsScrambled(packet)) {
+        return false;
+    }
+
+    if(!TsHasPayload(packet)) {
         return false;
     }
 
@@ -192,15 +259,12 @@ bool DemuxerBundle::processTsPacket(uint8_t* packet, int64_t streamPosition) {
         return false;
     }
 
-    bool pusi = TsPayloadStart(packet);
-
     // valid packet ?
-    if(pusi && !PesIsHeader(&packet[offset])) {
+    if(TsPayloadStart(packet) && !PesIsHeader(&packet[offset])) {
         return false;
     }
 
-    demuxer->setStreamPosition(streamPosition);
-    return demuxer->processTsPacket(packet);
+    return true;
 }
 
 void DemuxerBundle::reset() {
@@ -25,6 +25,10 @@
 #include "robotvdmx/pes.h"
 
 #include "parser.h"
+#include "syncscan.h"
+
+#include <algorithm>
+#include <stdlib.h>
 
 Parser::Parser(TsDemuxer* demuxer, int buffersize, int packetsize) : RingBuffer(buffersize, packetsize), m_demuxer(demuxer), m_startup(true) {
     m_sampleRate = 0;
@@ -33,6 +37,12 @@ Parser::Parser(TsDemuxer* demuxer, int buffersize, int packetsize) : RingBuffer(
     m_duration = 0;
     m_headerSize = 0;
     m_frameType = StreamInfo::FrameType::UNKNOWN;
+    m_syncWord = 0;
+    m_syncMask = 0;
+    m_outputBuffer = NULL;
+    m_outputBufferSize = 0;
+    m_outputFrame = NULL;
+    m_outputFrameLength = 0;
 
     m_curPts = DVD_NOPTS_VALUE;
     m_curDts = DVD_NOPTS_VALUE;
@@ -42,6 +52,7 @@ Parser::Parser(TsDemuxer* demuxer, int buffersize, int packetsize) : RingBuffer(
 }
 
 Parser::~Parser() {
+    ::free(m_outputBuffer);
 }
 
 int Parser::parsePesHeader(uint8_t* buf, int len) {
@@ -80,7 +91,22 @@ void Parser::sendPayload(unsigned char* payload, int length) {
     pkt.pts = m_curPts;
     pkt.frameType = m_frameType;
 
+    // parts of a frame (e.g. single pictures) are copied by the listener
+    if(m_outputBuffer != NULL && payload == m_outputFrame && length == m_outputFrameLength) {
+        pkt.buffer = m_outputBuffer;
+        pkt.bufferSize = m_outputBufferSize;
+    }
+
+    bool attached = (pkt.buffer != nullptr);
     m_demuxer->sendPacket(&pkt);
+
+    // buffer taken over by the listener ?
+    if(attached && pkt.buffer == nullptr) {
+        m_outputBuffer = NULL;
+        m_outputBufferSize = 0;
+        m_outputFrame = NULL;
+        m_outputFrameLength = 0;
+    }
 }
 
 void Parser::putData(unsigned char* data, int length, bool pusi) {
@@ -178,14 +204,33 @@ int Parser::parsePayload(unsigned char* payload, int length) {
 
 int Parser::findAlignmentOffset(unsigned char* buffer, int buffersize, int o, int& framesize) {
     framesize = 0;
+    int limit = buffersize - m_headerSize;
 
     // seek sync
-    while(o < (buffersize - m_headerSize) && !checkAlignmentHeader(buffer + o, framesize, false)) {
-        o++;
+    if(m_syncMask != 0) {
+        // only check the header at sync word candidates
+        int size = std::min(limit + 1, buffersize);
+
+        while((o = SyncScan::findSyncWord(buffer, size, o, m_syncWord, m_syncMask)) != -1) {
+            if(checkAlignmentHeader(buffer + o, framesize, false)) {
+                break;
+            }
+
+            o++;
+        }
+
+        if(o == -1) {
+            return -1;
+        }
+    }
+    else {
+        while(o < limit && !checkAlignmentHeader(buffer + o, framesize, false)) {
+            o++;
+        }
     }
 
     // not found
-    if(o >= buffersize - m_headerSize || framesize <= 0) {
+    if(o >= limit || framesize <= 0) {
         return -1;
     }
 
@@ -198,6 +243,42 @@ bool Parser::checkAlignmentHeader(unsigned char* buffer, int& framesize, bool pa
 }
 
 int Parser::findStartCode(unsigned char* buffer, int buffersize, int offset, uint32_t startcode, uint32_t mask) {
+    // start code ending with the prefix (00 00 01) ?
+    bool prefixLast = ((mask & 0x00FFFFFF) == 0x00FFFFFF && (startcode & 0x00FFFFFF) == 0x000001);
+
+    // start code beginning with the prefix (00 00 01 xx) ?
+    bool prefixFirst = ((mask & 0xFFFFFF00) == 0xFFFFFF00 && (startcode >> 8) == 0x000001);
+
+    if(!prefixLast && !prefixFirst) {
+        return findStartCodeScalar(buffer, buffersize, offset, startcode, mask);
+    }
+
+    int p = offset;
+
+    // check the 32 bit code around every prefix found
+    while((p = SyncScan::findStartCode(buffer, buffersize, p)) != -1) {
+        if(prefixLast) {
+            uint32_t sc = ((p > offset) ? (uint32_t)buffer[p - 1] << 24 : 0xFF000000) | 0x000001;
+
+            if((sc & mask) == startcode) {
+                return p - 1;
+            }
+        }
+        else if(p + 3 < buffersize) {
+            uint32_t sc = 0x00000100 | buffer[p + 3];
+
+            if((sc & mask) == startcode) {
+                return p;
+            }
+        }
+
+        p++;
+    }
+
+    return -1;
+}
+
+int Parser::findStartCodeScalar(unsigned char* buffer, int buffersize, int offset, uint32_t startcode, uint32_t mask) {
     uint32_t sc = 0xFFFFFFFF;
 
     while(offset < buffersize) {
@@ -39,7 +39,7 @@ public:
 
     virtual void reset();
 
-    void flush();
+    virtual void flush();
 
 protected:
 
@@ -53,6 +53,18 @@ protected:
 
     int findStartCode(unsigned char* buffer, int buffersize, int offset, uint32_t startcode, uint32_t mask = 0xFFFFFFFF);
 
+    /**
+     * Set the sync word of the stream.
+     * If set, the alignment header is only checked at offsets matching the
+     * sync word.
+     * @param word 16 bit sync word
+     * @param mask mask of the sync word (the first byte must be fully masked)
+     */
+    inline void setSyncWord(uint16_t word, uint16_t mask) {
+        m_syncWord = word;
+        m_syncMask = mask;
+    }
+
     TsDemuxer* m_demuxer;
 
     int64_t m_curPts;
@@ -73,6 +85,16 @@ protected:
 
     bool m_startup;
 
+    // malloc'ed payload memory passed along with the stream packets
+    uint8_t* m_outputBuffer;
+
+    int m_outputBufferSize;
+
+    // complete frame within the output buffer (the only payload handed over)
+    uint8_t* m_outputFrame;
+
+    int m_outputFrameLength;
+
 private:
 
     int64_t m_lastPts;
@@ -83,6 +105,12 @@ private:
 
     int findAlignmentOffset(unsigned char* buffer, int buffersize, int startoffset, int& framesize);
 
+    int findStartCodeScalar(unsigned char* buffer, int buffersize, int offset, uint32_t startcode, uint32_t mask);
+
+    uint16_t m_syncWord;
+
+    uint16_t m_syncMask;
+
 };
 
 #endif // ROBOTV_DEMUXER_BASE_H
@@ -31,6 +31,7 @@
 ParserAc3::ParserAc3(TsDemuxer* demuxer) : Parser(demuxer, 64 * 1024, 4096) {
     m_headerSize = AC3_HEADER_SIZE;
     m_enhanced = false;
+    setSyncWord(0x0B77, 0xFFFF);
 }
 
 bool ParserAc3::checkAlignmentHeader(unsigned char* buffer, int& framesize, bool parse) {
@@ -29,6 +29,7 @@
 
 ParserAdts::ParserAdts(TsDemuxer* demuxer) : Parser(demuxer, 64 * 1024, 8192) {
     m_headerSize = 9; // header is 9 bytes long (with CRC)
+    setSyncWord(0xFFF0, 0xFFF0); // 12 bit syncword FFF
 }
 
 bool ParserAdts::ParseAudioHeader(uint8_t* buffer, int& channels, int& samplerate, int& framesize) {
@@ -24,6 +24,8 @@
 
 #include "parser_h264.h"
 
+#include <algorithm>
+
 // H264 profiles
 #define PROFILE_BASELINE  66
 #define PROFILE_MAIN      77
@@ -41,6 +43,9 @@
 #define NAL_SPS 0x07
 #define NAL_PPS 0x08
 
+// maximum number of (unescaped) slice header bytes we need
+#define SLH_MAXSIZE 32
+
 const ParserH264::pixel_aspect_t ParserH264::m_aspect_ratios[17] = {
     {0, 1}, { 1,  1}, {12, 11}, {10, 11}, {16, 11}, { 40, 33}, {24, 11}, {20, 11}, {32, 11},
     {80, 33}, {18, 11}, {15, 11}, {64, 33}, {160, 99}, { 4,  3}, { 3,  2}, { 2,  1}
@@ -48,35 +53,24 @@ const ParserH264::pixel_aspect_t ParserH264::m_aspect_ratios[17] = {
 
 // golomb decoding
 uint32_t ParserH264::readGolombUe(BitStream* bs) {
-    int leadingZeroBits = -1;
-
-    for(uint32_t b = 0; !b; ++leadingZeroBits) {
-        b = bs->getBits(1);
-    }
-
-    return ((1 << leadingZeroBits) - 1) + bs->getBits(leadingZeroBits);
+    return bs->getUe();
 }
 
 int32_t ParserH264::readGolombSe(BitStream* bs) {
-    int32_t v = readGolombUe(bs);
-
-    if(v == 0) {
-        return 0;
-    }
-
-    int32_t neg = !(v & 1);
-    v = (v + 1) >> 1;
-
-    return neg ? -v : v;
+    return bs->getSe();
 }
 
-
 ParserH264::ParserH264(TsDemuxer* demuxer) : ParserPes(demuxer, 1024 * 1024) {
     m_scale = 0;
     m_rate = 0;
 }
 
-uint8_t* ParserH264::extractNal(uint8_t* packet, int length, int nal_offset, int& nal_len) {
+uint8_t* ParserH264::extractNal(uint8_t* packet, int length, int nal_offset, int& nal_len, int maxLength) {
+    // an escaped NAL of maxLength bytes takes at most 3/2 * maxLength bytes
+    if(maxLength > 0) {
+        length = std::min(length, nal_offset + maxLength + maxLength / 2 + 4);
+    }
+
     int e = findStartCode(packet, length, nal_offset, 0x00000001);
 
     if(e == -1) {
@@ -89,10 +83,17 @@ uint8_t* ParserH264::extractNal(uint8_t* packet, int length, int nal_offset, int
         return NULL;
     }
 
-    uint8_t* nal_data = new uint8_t[l];
-    nal_len = nalUnescape(nal_data, packet + nal_offset, l);
+    if(maxLength <= 0 || maxLength > l) {
+        maxLength = l;
+    }
+
+    // reuse the scratch buffer
+    if(m_nalBuffer.size() < (size_t)maxLength) {
+        m_nalBuffer.resize(maxLength);
+    }
 
-    return nal_data;
+    nal_len = nalUnescape(m_nalBuffer.data(), packet + nal_offset, l, maxLength);
+    return m_nalBuffer.data();
 }
 
 int ParserH264::parsePayload(unsigned char* data, int length) {
@@ -121,11 +122,10 @@ int ParserH264::parsePayload(unsigned char* data, int length) {
         // NAL_SLH
         if(nal_type == NAL_SLH && length - o > 1) {
             o++;
-            uint8_t* nal_data = extractNal(data, length, o, nal_len);
+            uint8_t* nal_data = extractNal(data, length, o, nal_len, SLH_MAXSIZE);
 
             if(nal_data != NULL) {
                 parseSlh(nal_data, nal_len);
-                delete[] nal_data;
             }
         }
 
@@ -153,7 +153,6 @@ int ParserH264::parsePayload(unsigned char* data, int length) {
 
         if(pps_data != NULL) {
             m_demuxer->setVideoDecoderData(NULL, 0, pps_data, nal_len);
-            delete[] pps_data;
         }
     }
 
@@ -188,7 +187,6 @@ int ParserH264::parsePayload(unsigned char* data, int length) {
     }
 
     bool rc = parseSps(nal_data, nal_len, pixelaspect, width, height);
-    delete[] nal_data;
 
     if(!rc) {
         return length;
@@ -201,10 +199,10 @@ int ParserH264::parsePayload(unsigned char* data, int length) {
     return length;
 }
 
-int ParserH264::nalUnescape(uint8_t* dst, const uint8_t* src, int len) {
+int ParserH264::nalUnescape(uint8_t* dst, const uint8_t* src, int len, int maxLength) {
     int s = 0, d = 0;
 
-    while(s < len) {
+    while(s < len && d < maxLength) {
         if(s >= 2 && s < len - 1) {
             // hit 00 00 03 ?
             if(src[s - 2] == 0 && src[s - 1] == 0 && src[s] == 3) {
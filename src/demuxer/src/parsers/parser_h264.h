@@ -28,6 +28,8 @@
 #include <upstream/bitstream.h>
 #include "parser_pes.h"
 
+#include <vector>
+
 class ParserH264 : public ParserPes {
 public:
 
@@ -45,9 +47,19 @@ protected:
     // pixel aspect ratios
     static const pixel_aspect_t m_aspect_ratios[17];
 
-    uint8_t* extractNal(uint8_t* packet, int length, int nal_offset, int& nal_len);
+    /**
+     * Extract and unescape a NAL unit.
+     * The returned data is valid until the next call.
+     * @param packet pointer to the payload
+     * @param length length of the payload
+     * @param nal_offset offset of the NAL unit
+     * @param nal_len length of the unescaped NAL unit
+     * @param maxLength maximum number of unescaped bytes (0 = complete NAL unit)
+     * @return pointer to the unescaped NAL unit or NULL
+     */
+    uint8_t* extractNal(uint8_t* packet, int length, int nal_offset, int& nal_len, int maxLength = 0);
 
-    int nalUnescape(uint8_t* dst, const uint8_t* src, int len);
+    int nalUnescape(uint8_t* dst, const uint8_t* src, int len, int maxLength);
 
     uint32_t readGolombUe(BitStream* bs);
 
@@ -63,6 +75,8 @@ private:
 
     void parseSlh(uint8_t* buf, int len);
 
+    std::vector<uint8_t> m_nalBuffer;
+
 };
 
 
@@ -72,7 +72,6 @@ int ParserH265::parsePayload(unsigned char* data, int length) {
 
             if(pps_data != NULL) {
                 m_demuxer->setVideoDecoderData(NULL, 0, pps_data, nal_len);
-                delete[] pps_data;
             }
         }
 
@@ -83,7 +82,6 @@ int ParserH265::parsePayload(unsigned char* data, int length) {
 
             if(vps_data != NULL) {
                 m_demuxer->setVideoDecoderData(NULL, 0, NULL, 0, vps_data, nal_len);
-                delete[] vps_data;
             }
         }
 
@@ -114,7 +112,6 @@ int ParserH265::parsePayload(unsigned char* data, int length) {
     pixel_aspect_t pixelaspect = { 1, 1 };
 
     bool rc = parseSps(nal_data, nal_len, pixelaspect, width, height);
-    delete[] nal_data;
 
     if(!rc) {
         return length;
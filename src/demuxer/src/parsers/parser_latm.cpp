@@ -28,6 +28,7 @@
 #include "parser_latm.h"
 
 ParserLatm::ParserLatm(TsDemuxer* demuxer) : Parser(demuxer, 64 * 1024, 8192) { //, m_framelength(0)
+    setSyncWord(0x56E0, 0xFFE0); // 11 bit syncword 2B7
 }
 
 bool ParserLatm::checkAlignmentHeader(unsigned char* buffer, int& framesize, bool parse) {
@@ -51,6 +51,7 @@ const int SlotSizes[3] = { 4, 1, 1 };
 
 ParserMpeg2Audio::ParserMpeg2Audio(TsDemuxer* demuxer) : Parser(demuxer, 64 * 1024, 2048) {
     m_headerSize = 4;
+    setSyncWord(0xFFE0, 0xFFE0); // 11 bit syncword FFE
 }
 
 bool ParserMpeg2Audio::parseAudioHeader(uint8_t* buffer, int& channels, int& samplerate, int& bitrate, int& framesize) {
@@ -26,49 +26,139 @@
 
 #include "parser_pes.h"
 
-ParserPes::ParserPes(TsDemuxer* demuxer, int buffersize) : Parser(demuxer, buffersize, 0) {
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+// unused space behind the payload (for trailing data of the listener)
+#define PES_TAILROOM 16
+
+ParserPes::ParserPes(TsDemuxer* demuxer, int buffersize) : Parser(demuxer, 0, 0) {
     m_startup = true;
+    m_maxFrameSize = buffersize;
+    m_frameLength = 0;
+    m_lastFrameLength = 0;
+    m_headroom = 0;
+    m_pesLength = 0;
 }
 
 void ParserPes::parse(unsigned char* data, int size, bool pusi) {
 
     // packet completely assembled ?
-    if(!m_startup) {
-        int length = 0;
-        uint8_t* buffer = get(length);
-
-        if(pusi && buffer != NULL) {
-            // parse payload
-            if(length > 0) {
-                int len = parsePayload(buffer, length);
-
-                // send payload data
-                sendPayload(buffer, len);
-            }
-
-            m_curDts = DVD_NOPTS_VALUE;
-            m_curPts = DVD_NOPTS_VALUE;
-        }
+    if(!m_startup && pusi && m_frameLength > 0) {
+        sendFrame();
+
+        m_curDts = DVD_NOPTS_VALUE;
+        m_curPts = DVD_NOPTS_VALUE;
     }
 
     // new packet
     if(pusi) {
         // strip PES header
         int offset = parsePesHeader(data, size);
+
+        // payload length (if signalled)
+        m_pesLength = PesHasLength(data) ? std::max(PesLength(data) - offset, 0) : 0;
+
         data += offset;
         size -= offset;
         m_startup = false;
 
         // reset buffer
-        clear();
+        m_frameLength = 0;
     }
 
     // we start with the beginning of a packet
-    if(!m_startup) {
-        if(put(data, size) < size) {
-            // clear buffer on overflow
-            clear();
-            m_startup = true;
-        }
+    if(!m_startup && !append(data, size)) {
+        // clear buffer on overflow
+        m_frameLength = 0;
+        m_startup = true;
+    }
+}
+
+void ParserPes::reset() {
+    Parser::reset();
+    m_frameLength = 0;
+}
+
+void ParserPes::flush() {
+    if(m_frameLength > 0) {
+        sendFrame();
+    }
+
+    m_frameLength = 0;
+}
+
+bool ParserPes::append(unsigned char* data, int size) {
+    if(size <= 0 || data == NULL) {
+        return true;
+    }
+
+    if(m_frameLength + size >= m_maxFrameSize) {
+        return false;
+    }
+
+    if(!reserveFrame(m_frameLength + size)) {
+        return false;
+    }
+
+    memcpy(m_outputBuffer + m_headroom + m_frameLength, data, size);
+    m_frameLength += size;
+
+    return true;
+}
+
+bool ParserPes::reserveFrame(int length) {
+    if(m_outputBuffer == NULL) {
+        m_headroom = m_demuxer->getPacketHeadroom();
+    }
+    else if(m_headroom + length + PES_TAILROOM <= m_outputBufferSize) {
+        return true;
+    }
+
+    // PES packet length known -> allocate the whole frame at once
+    if(m_pesLength >= length) {
+        length = std::min(m_pesLength, m_maxFrameSize);
+    }
+    // new buffer, sized for the last frame
+    else if(m_outputBuffer == NULL) {
+        length = std::max(length, std::min(m_lastFrameLength + m_lastFrameLength / 4, m_maxFrameSize));
     }
+    else {
+        length = std::min(std::max(length, 2 * (m_outputBufferSize - m_headroom)), m_maxFrameSize);
+    }
+
+    int size = m_headroom + length + PES_TAILROOM;
+    uint8_t* buffer = (uint8_t*)realloc(m_outputBuffer, size);
+
+    if(buffer == NULL) {
+        return false;
+    }
+
+    m_outputBuffer = buffer;
+    m_outputBufferSize = size;
+
+    return true;
+}
+
+void ParserPes::sendFrame() {
+    int length = m_frameLength;
+
+    m_lastFrameLength = length;
+
+    uint8_t* buffer = m_outputBuffer + m_headroom;
+
+    m_outputFrame = buffer;
+    m_outputFrameLength = length;
+
+    // parse payload
+    int len = parsePayload(buffer, length);
+
+    // send payload data (unless already taken over)
+    if(m_outputBuffer != NULL) {
+        sendPayload(buffer, len);
+    }
+
+    m_outputFrame = NULL;
+    m_outputFrameLength = 0;
 }
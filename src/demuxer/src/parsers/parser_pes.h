@@ -27,6 +27,12 @@
 
 #include "parser.h"
 
+/**
+ * PES packet parser.
+ * Assembles complete PES packets directly into the output buffer passed
+ * with the stream packet. The listener may take over this buffer without
+ * copying the payload (the buffer is reused otherwise).
+ */
 class ParserPes : public Parser {
 public:
 
@@ -34,6 +40,29 @@ public:
 
     void parse(unsigned char* data, int size, bool pusi);
 
+    void reset();
+
+    void flush();
+
+private:
+
+    bool append(unsigned char* data, int size);
+
+    bool reserveFrame(int length);
+
+    void sendFrame();
+
+    int m_maxFrameSize;
+
+    int m_frameLength;
+
+    int m_lastFrameLength;
+
+    int m_headroom;
+
+    // payload length of the current PES packet (0 = unbounded)
+    int m_pesLength;
+
 };
 
 #endif // ROBOTV_DEMUXER_PES_H
@@ -0,0 +1,218 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "syncscan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SYNCSCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef int (*StartCodeScanner)(const uint8_t* buffer, int size, int offset);
+typedef int (*SyncWordScanner)(const uint8_t* buffer, int size, int offset, uint8_t first, uint8_t mask, uint8_t second);
+
+int findStartCodeScalar(const uint8_t* buffer, int size, int offset) {
+    for(int p = offset; p + 2 < size; p++) {
+        // skip ahead quickly if the third byte can't be part of a prefix
+        if(buffer[p + 2] > 1) {
+            p += 2;
+            continue;
+        }
+
+        if(buffer[p] == 0 && buffer[p + 1] == 0 && buffer[p + 2] == 1) {
+            return p;
+        }
+    }
+
+    return -1;
+}
+
+int findSyncWordScalar(const uint8_t* buffer, int size, int offset, uint8_t first, uint8_t mask, uint8_t second) {
+    for(int p = offset; p + 1 < size; p++) {
+        if(buffer[p] == first && (buffer[p + 1] & mask) == second) {
+            return p;
+        }
+    }
+
+    return -1;
+}
+
+#ifdef SYNCSCAN_X86
+
+__attribute__((target("sse2")))
+int findStartCodeSse2(const uint8_t* buffer, int size, int offset) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+
+    int p = offset;
+
+    for(; p + 18 <= size; p += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(buffer + p));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(buffer + p + 1));
+        __m128i b2 = _mm_loadu_si128((const __m128i*)(buffer + p + 2));
+
+        __m128i m = _mm_and_si128(
+                        _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)),
+                        _mm_cmpeq_epi8(b2, one));
+
+        int bits = _mm_movemask_epi8(m);
+
+        if(bits != 0) {
+            return p + __builtin_ctz(bits);
+        }
+    }
+
+    return findStartCodeScalar(buffer, size, p);
+}
+
+__attribute__((target("sse2")))
+int findSyncWordSse2(const uint8_t* buffer, int size, int offset, uint8_t first, uint8_t mask, uint8_t second) {
+    const __m128i f = _mm_set1_epi8((char)first);
+    const __m128i m = _mm_set1_epi8((char)mask);
+    const __m128i s = _mm_set1_epi8((char)second);
+
+    int p = offset;
+
+    for(; p + 17 <= size; p += 16) {
+        __m128i b0 = _mm_loadu_si128((const __m128i*)(buffer + p));
+        __m128i b1 = _mm_loadu_si128((const __m128i*)(buffer + p + 1));
+
+        __m128i r = _mm_and_si128(
+                        _mm_cmpeq_epi8(b0, f),
+                        _mm_cmpeq_epi8(_mm_and_si128(b1, m), s));
+
+        int bits = _mm_movemask_epi8(r);
+
+        if(bits != 0) {
+            return p + __builtin_ctz(bits);
+        }
+    }
+
+    return findSyncWordScalar(buffer, size, p, first, mask, second);
+}
+
+__attribute__((target("avx2")))
+int findStartCodeAvx2(const uint8_t* buffer, int size, int offset) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+
+    int p = offset;
+
+    for(; p + 34 <= size; p += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(buffer + p));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(buffer + p + 1));
+        __m256i b2 = _mm256_loadu_si256((const __m256i*)(buffer + p + 2));
+
+        __m256i m = _mm256_and_si256(
+                        _mm256_and_si256(_mm256_cmpeq_epi8(b0, zero), _mm256_cmpeq_epi8(b1, zero)),
+                        _mm256_cmpeq_epi8(b2, one));
+
+        unsigned int bits = (unsigned int)_mm256_movemask_epi8(m);
+
+        if(bits != 0) {
+            return p + __builtin_ctz(bits);
+        }
+    }
+
+    return findStartCodeSse2(buffer, size, p);
+}
+
+__attribute__((target("avx2")))
+int findSyncWordAvx2(const uint8_t* buffer, int size, int offset, uint8_t first, uint8_t mask, uint8_t second) {
+    const __m256i f = _mm256_set1_epi8((char)first);
+    const __m256i m = _mm256_set1_epi8((char)mask);
+    const __m256i s = _mm256_set1_epi8((char)second);
+
+    int p = offset;
+
+    for(; p + 33 <= size; p += 32) {
+        __m256i b0 = _mm256_loadu_si256((const __m256i*)(buffer + p));
+        __m256i b1 = _mm256_loadu_si256((const __m256i*)(buffer + p + 1));
+
+        __m256i r = _mm256_and_si256(
+                        _mm256_cmpeq_epi8(b0, f),
+                        _mm256_cmpeq_epi8(_mm256_and_si256(b1, m), s));
+
+        unsigned int bits = (unsigned int)_mm256_movemask_epi8(r);
+
+        if(bits != 0) {
+            return p + __builtin_ctz(bits);
+        }
+    }
+
+    return findSyncWordSse2(buffer, size, p, first, mask, second);
+}
+
+#endif // SYNCSCAN_X86
+
+struct Scanner {
+    const char* name;
+    StartCodeScanner startCode;
+    SyncWordScanner syncWord;
+};
+
+Scanner selectScanner() {
+#ifdef SYNCSCAN_X86
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx2")) {
+        return { "avx2", findStartCodeAvx2, findSyncWordAvx2 };
+    }
+
+    if(__builtin_cpu_supports("sse2")) {
+        return { "sse2", findStartCodeSse2, findSyncWordSse2 };
+    }
+#endif
+
+    return { "scalar", findStartCodeScalar, findSyncWordScalar };
+}
+
+const Scanner& scanner() {
+    static const Scanner s = selectScanner();
+    return s;
+}
+
+}
+
+int SyncScan::findStartCode(const uint8_t* buffer, int size, int offset) {
+    if(buffer == nullptr || offset < 0) {
+        return -1;
+    }
+
+    return scanner().startCode(buffer, size, offset);
+}
+
+int SyncScan::findSyncWord(const uint8_t* buffer, int size, int offset, uint16_t word, uint16_t mask) {
+    if(buffer == nullptr || offset < 0) {
+        return -1;
+    }
+
+    return scanner().syncWord(buffer, size, offset, (uint8_t)(word >> 8), (uint8_t)(mask & 0xFF), (uint8_t)(word & mask & 0xFF));
+}
+
+const char* SyncScan::implementation() {
+    return scanner().name;
+}
@@ -0,0 +1,68 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_SYNCSCAN_H
+#define ROBOTV_SYNCSCAN_H
+
+#include <stdint.h>
+
+/**
+ * Sync scanners for the parsers.
+ * Locates start code prefixes and audio sync words in a buffer. Vectorized
+ * (SSE2 / AVX2) implementations are selected at runtime on x86, all other
+ * platforms use the portable scalar versions.
+ */
+class SyncScan {
+public:
+
+    /**
+     * Find a start code prefix (00 00 01).
+     * @param buffer pointer to the data
+     * @param size size of the buffer
+     * @param offset start offset
+     * @return offset of the first prefix byte or -1 if not found
+     */
+    static int findStartCode(const uint8_t* buffer, int size, int offset);
+
+    /**
+     * Find a 16 bit sync word.
+     * The first byte of the sync word must match exactly, the second byte
+     * is compared with the lower 8 bits of the mask.
+     * @param buffer pointer to the data
+     * @param size size of the buffer
+     * @param offset start offset
+     * @param word sync word
+     * @param mask sync word mask (upper 8 bits must be 0xFF)
+     * @return offset of the sync word or -1 if not found
+     */
+    static int findSyncWord(const uint8_t* buffer, int size, int offset, uint16_t word, uint16_t mask);
+
+    /**
+     * Name of the selected implementation.
+     */
+    static const char* implementation();
+
+};
+
+#endif // ROBOTV_SYNCSCAN_H
@@ -131,6 +131,21 @@ bool StreamInfo::isMetaOf(const StreamInfo& rhs) const {
     return (m_pid == rhs.m_pid);
 }
 
+bool StreamInfo::isSameStream(const StreamInfo& rhs) const {
+    if(!isMetaOf(rhs) || m_type != rhs.m_type) {
+        return false;
+    }
+
+    if(strcmp(m_language, rhs.m_language) != 0) {
+        return false;
+    }
+
+    return
+        (m_subTitlingType == rhs.m_subTitlingType) &&
+        (m_compositionPageId == rhs.m_compositionPageId) &&
+        (m_ancillaryPageId == rhs.m_ancillaryPageId);
+}
+
 bool StreamInfo::operator !=(const StreamInfo& rhs) const {
     return !((*this) == rhs);
 }
@@ -37,16 +37,27 @@ int BitStream::getBit(void) {
     return r;
 }
 
-uint32_t BitStream::getBits(int n) {
+uint32_t BitStream::peekBitsSlow(int n) const {
     uint32_t r = 0;
 
-    while(n--) {
-        r |= getBit() << n;
+    for(int i = m_index; n--; i++) {
+        int bit = (i >= m_length) ? 1 : (m_data[i >> 3] >> (7 - (i & 7))) & 1;
+        r |= bit << n;
     }
 
     return r;
 }
 
+uint32_t BitStream::getUeSlow() {
+    int leadingZeroBits = -1;
+
+    for(uint32_t b = 0; !b; ++leadingZeroBits) {
+        b = getBit();
+    }
+
+    return ((1 << leadingZeroBits) - 1) + getBits(leadingZeroBits);
+}
+
 void BitStream::byteAlign(void) {
     int n = m_index % 8;
 
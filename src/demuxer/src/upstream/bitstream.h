@@ -29,18 +29,85 @@
 #define ROBOTV_BITSTREAM_H
 
 #include <stdint.h>
+#include <string.h>
+#include <endian.h>
 
 class BitStream {
 public:
 
-    BitStream(const uint8_t* data, int length) : m_data(data), m_length(length), m_index(0) {
+    BitStream(const uint8_t* data, int length) : m_data(data), m_length(length), m_index(0), m_size((length + 7) / 8) {
     }
 
     ~BitStream() {}
 
     int getBit(void);
 
-    uint32_t getBits(int n);
+    /**
+     * Read up to 32 bits.
+     * Bits beyond the end of the stream are read as 1.
+     */
+    inline uint32_t getBits(int n) {
+        uint32_t r = peekBits(n);
+        advance(n);
+        return r;
+    }
+
+    /**
+     * Read up to 32 bits without advancing the stream.
+     */
+    inline uint32_t peekBits(int n) const {
+        if(n <= 0) {
+            return 0;
+        }
+
+        // bits beyond the end of the stream
+        if(m_index < 0 || m_index + n > m_length) {
+            return peekBitsSlow(n);
+        }
+
+        // load 64 bits at once (zero-padded at the end of the data)
+        int byte = m_index >> 3;
+        uint64_t w = 0;
+
+        memcpy(&w, m_data + byte, (byte + 8 <= m_size) ? 8 : m_size - byte);
+        w = be64toh(w) << (m_index & 7);
+
+        return (uint32_t)(w >> (64 - n));
+    }
+
+    /**
+     * Read an unsigned Exp-Golomb code.
+     */
+    inline uint32_t getUe() {
+        uint32_t w = peekBits(32);
+
+        // codes up to 31 bits
+        if(w >= 0x10000) {
+            int leadingZeroBits = __builtin_clz(w);
+            int n = 2 * leadingZeroBits + 1;
+
+            advance(n);
+            return (w >> (32 - n)) - 1;
+        }
+
+        return getUeSlow();
+    }
+
+    /**
+     * Read a signed Exp-Golomb code.
+     */
+    inline int32_t getSe() {
+        int32_t v = getUe();
+
+        if(v == 0) {
+            return 0;
+        }
+
+        int32_t neg = !(v & 1);
+        v = (v + 1) >> 1;
+
+        return neg ? -v : v;
+    }
 
     void byteAlign(void);
 
@@ -78,9 +145,21 @@ public:
 
 private:
 
+    // advance the read position (stops at the end of the stream)
+    inline void advance(int n) {
+        if(n > 0 && m_index < m_length) {
+            m_index = (m_index + n < m_length) ? m_index + n : m_length;
+        }
+    }
+
+    uint32_t peekBitsSlow(int n) const;
+
+    uint32_t getUeSlow();
+
     const uint8_t* m_data;
     int m_length; // in bits
     int m_index; // in bits
+    int m_size; // in bytes
 };
 
 #endif // ROBOTV_BITSTREAM_H
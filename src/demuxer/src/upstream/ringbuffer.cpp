@@ -29,37 +29,101 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <vdr/tools.h>
 
 RingBuffer::RingBuffer(int size, int margin) {
     m_size = size;
     m_tail = m_head = m_margin = margin;
     m_gotten = 0;
+    m_mirrored = false;
     m_buffer = NULL;
 
     if(size > 1) {  // 'Size - 1' must not be 0!
         if(margin <= size / 2) {
-            m_buffer = (uint8_t*)malloc((size_t)size);
+            if(!createMirror(size)) {
+                m_buffer = (uint8_t*)malloc((size_t)size);
+            }
+
             clear();
         }
     }
 }
 
 RingBuffer::~RingBuffer() {
+    if(m_mirrored) {
+        munmap(m_buffer, 2 * (size_t)m_size);
+        return;
+    }
+
     ::free(m_buffer);
 }
 
+bool RingBuffer::createMirror(int size) {
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+    long pageSize = sysconf(_SC_PAGESIZE);
+
+    if(pageSize <= 0) {
+        return false;
+    }
+
+    size_t length = ((size_t)size + pageSize - 1) & ~((size_t)pageSize - 1);
+
+    int fd = memfd_create("robotv-ringbuffer", MFD_CLOEXEC);
+
+    if(fd == -1) {
+        return false;
+    }
+
+    if(ftruncate(fd, (off_t)length) == -1) {
+        close(fd);
+        return false;
+    }
+
+    // reserve address space for both mappings
+    uint8_t* buffer = (uint8_t*)mmap(NULL, 2 * length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if(buffer == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // map the same pages twice
+    if(mmap(buffer, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+            mmap(buffer + length, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(buffer, 2 * length);
+        close(fd);
+        return false;
+    }
+
+    close(fd);
+
+    m_size = (int)length;
+    m_buffer = buffer;
+    m_mirrored = true;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 int RingBuffer::onDataReady(const uint8_t* data, int count) {
     return count >= m_margin ? count : 0;
 }
 
 int RingBuffer::available(void) const {
     int diff = m_head - m_tail;
+
+    if(m_mirrored) {
+        return (diff >= 0) ? diff : size() + diff;
+    }
+
     return (diff >= 0) ? diff : size() + diff - m_margin;
 }
 
 void RingBuffer::clear(void) {
-    m_tail = m_head = m_margin;
+    m_tail = m_head = (m_mirrored ? 0 : m_margin);
 }
 
 int RingBuffer::put(const uint8_t *data, int count) {
@@ -67,6 +131,26 @@ int RingBuffer::put(const uint8_t *data, int count) {
         return count;
     }
 
+    // the mirror makes every block contiguous
+    if(m_mirrored) {
+        int free = size() - available() - 1;
+
+        if(free <= 0) {
+            esyslog("ringbuffer: unable to write %i bytes - overflow", count);
+            return 0;
+        }
+
+        if(free < count) {
+            esyslog("ringbuffer: not enough space - writing %i bytes out of %i", free, count);
+            count = free;
+        }
+
+        memcpy(m_buffer + m_head, data, (size_t)count);
+        m_head = (m_head + count) % size();
+
+        return count;
+    }
+
     int Tail = m_tail;
     int rest = size() - m_head;
     int diff = Tail - m_head;
@@ -101,6 +185,18 @@ int RingBuffer::put(const uint8_t *data, int count) {
 }
 
 uint8_t* RingBuffer::get(int &count) {
+    if(m_mirrored) {
+        uint8_t* p = m_buffer + m_tail;
+        int cont = onDataReady(p, available());
+
+        if(cont > 0) {
+            count = m_gotten = cont;
+            return p;
+        }
+
+        return nullptr;
+    }
+
     int Head = m_head;
     int rest = size() - m_tail;
 
@@ -141,6 +237,11 @@ void RingBuffer::del(int count) {
     tail += count;
     m_gotten -= count;
 
+    if(m_mirrored) {
+        m_tail = tail % size();
+        return;
+    }
+
     if(tail >= size()) {
         tail = m_margin;
     }
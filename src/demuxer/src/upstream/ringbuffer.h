@@ -38,8 +38,11 @@ private:
     int m_head;
     int m_tail;
     int m_gotten;
+    bool m_mirrored;
     uint8_t* m_buffer;
 
+    bool createMirror(int size);
+
 protected:
     int size(void) const {
         return m_size;
@@ -64,6 +67,10 @@ public:
      * The buffer will be able to hold at most size-margin-1 bytes of data, and will
      * be guaranteed to return at least margin bytes in one consecutive block.
      *
+     * If supported, the buffer pages are mapped twice back to back (mirrored). All
+     * available data is then returned in one block without copying, and the
+     * buffer is able to hold size-1 bytes (size rounded up to the page size).
+     *
      * @param size total size of the buffer
      * @param margin block size
      */
@@ -74,7 +81,11 @@ public:
     int available(void) const;
 
     int free(void) const {
-        return size() - available() - 1 - m_margin;
+        return size() - available() - 1 - (m_mirrored ? 0 : m_margin);
+    }
+
+    bool mirrored(void) const {
+        return m_mirrored;
     }
 
     /**
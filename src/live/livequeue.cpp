@@ -23,48 +23,115 @@
  */
 
 #include <sys/types.h>
-#include <dirent.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "config/config.h"
 #include "net/msgpacket.h"
+#include "robotv/robotvcommand.h"
 #include "livequeue.h"
+#include "timeshiftscheduler.h"
 #include "tools/time.h"
 
-std::string LiveQueue::m_timeShiftDir;
-uint64_t LiveQueue::m_bufferSize = 1024 * 1024 * 1024;
+std::mutex LiveQueue::m_storageMutex;
+std::set<std::string> LiveQueue::m_storageInUse;
+std::map<std::string, std::chrono::milliseconds> LiveQueue::m_detachedStorage;
+bool LiveQueue::m_timeShiftOnDemand = true;
+uint64_t LiveQueue::m_maxMemorySize = 64 * 1024 * 1024;
+int LiveQueue::m_maxMemoryTime = 60;
+int LiveQueue::m_compactionAge = 0;
 
-LiveQueue::LiveQueue(int socket) : m_readFd(-1), m_writeFd(-1), m_socket(socket) {
-    m_wrapped = false;
-    m_hasWrapped = false;
+// maximum number of packets held in memory for a reader in live mode.
+// if the client falls behind the live window, the reader will continue
+// in the timeshift buffer.
+#define LIVEWINDOW_MAXPACKETS 400
+
+// fill level of the writer queue at which non-reference frames (B-Frames)
+// won't be written into the timeshift buffer anymore
+#define WRITERQUEUE_HIGHWATER 384
+
+// maximum size of a timeshift segment
+#define TIMESHIFT_SEGMENTSIZE (64 * 1024 * 1024)
+
+// time (in seconds) the timeshift storage will be kept for reconnecting clients
+#define TIMESHIFT_RECONNECT_TIMEOUT 120
+
+#define TIMESHIFT_PREFIX "robotv-timeshift-"
+
+// limits of the GOP cache (new readers start with the last keyframe).
+// longer GOPs won't be cached.
+#define GOPCACHE_MAXPACKETS 256
+#define GOPCACHE_MAXSIZE (16 * 1024 * 1024)
+
+LiveQueue::LiveQueue(int id, uint32_t channelUid) : m_id(id), m_memorySize(0), m_keepStorage(true), m_segmentNumber(0) {
     m_writerRunning = true;
-    m_wrapCount = 0;
+    m_writerWaiting = false;
+    m_packetsWritten = 0;
+    m_packetsDropped = 0;
+    m_nonReferenceDropped = 0;
+    m_bytesCompacted = 0;
+    m_writePosition = 0;
     m_queueStartTime = roboTV::currentTimeMillis();
-    m_lastSyncTime = roboTV::currentTimeMillis();
     m_writeThread = nullptr;
-    m_pause = false;
+    m_sequence = 0;
+    m_gopCacheSize = 0;
+    m_timeShift = false;
 
-    if(m_timeShiftDir.empty()) {
-        m_timeShiftDir = "/video";
+    TimeShiftScheduler& scheduler = TimeShiftScheduler::instance();
+    m_segmentSize = (off_t)std::min<uint64_t>(TIMESHIFT_SEGMENTSIZE, scheduler.getMaxBufferSize() / 4);
+
+    std::lock_guard<std::mutex> lock(m_storageMutex);
+    std::chrono::milliseconds now = roboTV::currentTimeMillis();
+
+    // remove expired storages
+    for(auto i = m_detachedStorage.begin(); i != m_detachedStorage.end();) {
+        if(now - i->second < std::chrono::seconds(TIMESHIFT_RECONNECT_TIMEOUT)) {
+            i++;
+            continue;
+        }
+
+        scheduler.removeFiles(TIMESHIFT_PREFIX + i->first + "-");
+        i = m_detachedStorage.erase(i);
+    }
+
+    m_storageName = *cString::sprintf("%08x", channelUid);
+
+    // channel already running (other language) - use a private storage
+    if(m_storageInUse.find(m_storageName) != m_storageInUse.end()) {
+        m_storageName = *cString::sprintf("%08x.%05i", channelUid, id);
+        m_keepStorage = false;
+        return;
+    }
+
+    m_storageInUse.insert(m_storageName);
+
+    // continue with the timeshift buffer of a previous client
+    if(m_detachedStorage.erase(m_storageName) > 0) {
+        loadStorage();
     }
 }
 
 LiveQueue::~LiveQueue() {
-    m_writerRunning = false;
-    close();
+    {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_writerRunning = false;
+        m_writerCondition.notify_one();
+    }
 
     if(m_writeThread != nullptr) {
         m_writeThread->join();
+        TimeShiftScheduler::instance().removeBuffer();
     }
 
-    while(!m_writerQueue.empty()) {
-        const PacketData& p = m_writerQueue.front();
-        delete p.p;
-        m_writerQueue.pop_front();
+    PacketData p{};
+
+    while(m_writerQueue.pop(p)) {
     }
 
+    close();
+
     delete m_writeThread;
     isyslog("LiveQueue terminated");
 }
@@ -75,317 +142,923 @@ void LiveQueue::start() {
     }
 
     // set queue start time
-    m_queueStartTime = roboTV::currentTimeMillis();
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+        m_queueStartTime = roboTV::currentTimeMillis();
+    }
+
+    TimeShiftScheduler::instance().addBuffer();
 
     m_writeThread = new std::thread([&]() {
-        createRingBuffer();
+        PacketData p{};
 
         while(m_writerRunning) {
 
-            while(m_writerRunning && !m_writerQueue.empty()) {
-                PacketData p{};
+            // drain the queue
+            while(m_writerRunning && m_writerQueue.pop(p)) {
+                append(p);
+                p = PacketData();
+            }
 
-                {
-                    std::lock_guard<std::mutex> lock(m_mutexQueue);
-                    p = m_writerQueue.front();
-                    m_writerQueue.pop_front();
-                }
+            // write aged packets to disk
+            spill(false);
 
-                write(p);
-            }
+            // shrink old segments
+            compact();
+
+            // wait for new packets
+            std::unique_lock<std::mutex> lock(m_writerMutex);
+            m_writerWaiting = true;
+
+            m_writerCondition.wait_for(lock, std::chrono::milliseconds(1000), [&]() {
+                return !m_writerRunning || !m_writerQueue.empty();
+            });
 
-            if(m_writerRunning) {
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            m_writerWaiting = false;
+        }
+
+        // keep the whole buffer for reconnecting clients
+        if(m_keepStorage) {
+            while(m_writerQueue.pop(p)) {
+                append(p);
             }
+
+            spill(true);
         }
     });
 
 }
 
-void LiveQueue::createRingBuffer() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void LiveQueue::loadStorage() {
+    // m_storageMutex must be locked by the caller
+    TimeShiftScheduler& scheduler = TimeShiftScheduler::instance();
+    std::string prefix = TIMESHIFT_PREFIX + m_storageName + "-";
+    uint64_t start = 0;
+
+    for(auto& baseName: scheduler.findSegments(prefix)) {
+        auto segment = scheduler.openSegment(baseName, start);
+
+        if(segment == nullptr || segment->getLength() == 0) {
+            continue;
+        }
+
+        for(auto& i: segment->loadIndex()) {
+            m_indexList.push_back({start + i.offset, std::chrono::milliseconds(i.wallclockTime), i.pts});
+        }
+
+        m_segments.push_back(segment);
+
+        std::string name = baseName.substr(baseName.rfind('/') + 1);
+        m_segmentNumber = strtoull(name.c_str() + prefix.size(), nullptr, 10) + 1;
+
+        start = segment->getEnd();
+    }
+
+    if(m_indexList.empty()) {
+        m_segments.clear();
+        scheduler.removeFiles(prefix);
+        return;
+    }
+
+    m_writePosition = start;
+    m_queueStartTime = m_indexList.front().wallclockTime;
 
-    m_pause = false;
-    off_t length = (off_t)m_bufferSize + 1024 * 1024;
+    // continue recording into the existing timeshift buffer
+    m_timeShift = true;
 
-    m_storage = cString::sprintf("%s/robotv-ringbuffer-%05i.data", m_timeShiftDir.c_str(), m_socket);
-    dsyslog("timeshift file: %s", (const char*)m_storage);
+    isyslog("continuing timeshift storage %s (%lu segments, %lu bytes)", m_storageName.c_str(), m_segments.size(), start);
+}
 
-    m_writeFd = open(m_storage, O_CREAT | O_WRONLY, 0644);
-    int rc = posix_fallocate(m_writeFd, 0, length);
+std::shared_ptr<TimeShiftSegment> LiveQueue::createSegment(uint64_t start) {
+    TimeShiftScheduler& scheduler = TimeShiftScheduler::instance();
 
-    if(rc != 0) {
-        dsyslog("unable to pre-allocate %li bytes for timeshift ringbuffer", length);
-        dsyslog("ERROR: %s (status = %i)", strerror(rc), rc);
+    // flush the completed segment
+    if(!m_segments.empty()) {
+        scheduler.sync(m_segments.back());
     }
 
-    m_readFd = open(m_storage, O_NOATIME | O_RDONLY, 0644);
+    // make room for the new segment
+    uint64_t bufferSize = scheduler.getBufferSize();
+    trim(bufferSize > (uint64_t)m_segmentSize ? bufferSize - m_segmentSize : 0, start);
+
+    std::string name = *cString::sprintf(TIMESHIFT_PREFIX "%s-%06lu", m_storageName.c_str(), m_segmentNumber++);
+    auto segment = scheduler.createSegment(name, start, m_segmentSize);
 
-    if(m_readFd == -1) {
-        esyslog("Failed to create timeshift ringbuffer !");
+    if(segment == nullptr) {
+        return nullptr;
     }
 
-    lseek(m_readFd, 0, SEEK_SET);
-    lseek(m_writeFd, 0, SEEK_SET);
+    std::lock_guard<std::mutex> lock(m_mutexSegments);
+    m_segments.push_back(segment);
 
+    return segment;
 }
 
-MsgPacket* LiveQueue::read() {
-    std::lock_guard<std::mutex> lock(m_mutex);
+std::shared_ptr<TimeShiftSegment> LiveQueue::findSegment(uint64_t position) {
+    std::lock_guard<std::mutex> lock(m_mutexSegments);
 
-    if(m_pause) {
+    if(m_segments.empty()) {
         return nullptr;
     }
 
-    return internalRead();
+    // first segment starting after the position
+    auto i = std::upper_bound(m_segments.begin(), m_segments.end(), position,
+    [](uint64_t pos, const std::shared_ptr<TimeShiftSegment>& s) {
+        return pos < s->getStart();
+    });
+
+    // position already trimmed -> oldest segment
+    if(i == m_segments.begin()) {
+        return m_segments.front();
+    }
+
+    auto segment = *(i - 1);
+
+    // position within a gap (lost packets) -> next segment
+    if(position >= segment->getEnd() && i != m_segments.end()) {
+        return *i;
+    }
+
+    return segment;
 }
 
-MsgPacket* LiveQueue::internalRead() {
-    // check if read position wrapped
+void LiveQueue::compact() {
+    if(m_compactionAge <= 0) {
+        return;
+    }
 
-    off_t readPosition = lseek(m_readFd, 0, SEEK_CUR);
-    off_t writePosition = lseek(m_writeFd, 0, SEEK_CUR);
+    std::chrono::milliseconds now = roboTV::currentTimeMillis();
 
-    if(readPosition == (off_t)-1 || writePosition == (off_t)-1) {
-        return nullptr;
+    // segments are only removed / replaced by the write thread
+    for(auto i = m_segments.begin(); i != m_segments.end() && (i + 1) != m_segments.end(); i++) {
+        auto segment = *i;
+
+        if(segment->isCompacted() || now - segment->getCreationTime() < std::chrono::seconds(m_compactionAge)) {
+            continue;
+        }
+
+        // one segment at a time
+        compactSegment(segment);
+        return;
     }
+}
+
+bool LiveQueue::compactSegment(const std::shared_ptr<TimeShiftSegment>& segment) {
+    std::set<uint16_t> droppable;
 
-    if(readPosition >= (off_t)m_bufferSize) {
-        isyslog("timeshift: read buffer wrap");
-        lseek(m_readFd, 0, SEEK_SET);
-        readPosition = 0;
-        m_wrapped = !m_wrapped;
-        isyslog("wrapped: %s", m_wrapped ? "yes" : "no");
+    {
+        std::lock_guard<std::mutex> lock(m_mutexQueue);
+        droppable = m_droppableStreams;
     }
 
-    // check if read position is still behind write position (if not wrapped))
-    // if not -> skip packet (as we would start reading from the beginning of
-    // the buffer)
+    auto compacted = TimeShiftScheduler::instance().createReplacement(*segment);
 
-    if(readPosition >= writePosition && !m_wrapped) {
-        return nullptr;
+    if(compacted == nullptr) {
+        return false;
+    }
+
+    // offsets of all packets (old -> new)
+    std::vector<std::pair<off_t, off_t>> offsets;
+    off_t offset = 0;
+
+    while(offset < segment->getLength()) {
+        MsgPacket* p = segment->read(offset);
+
+        if(p == nullptr) {
+            break;
+        }
+
+        off_t packetLength = p->getPacketLength();
+        bool drop = (p->getClientID() == (uint16_t)StreamInfo::FrameType::BFRAME);
+
+        // secondary streams
+        if(!drop && !droppable.empty() && p->getMsgID() == ROBOTV_STREAM_MUXPKT) {
+            p->rewind();
+            drop = (droppable.find(p->get_U16()) != droppable.end());
+        }
+
+        if(!drop) {
+            offsets.push_back({offset, compacted->getLength()});
+
+            if(p->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME) {
+                std::lock_guard<std::mutex> lock(m_mutexIndex);
+                uint64_t position = segment->getStart() + offset;
+
+                auto i = std::lower_bound(m_indexList.begin(), m_indexList.end(), position,
+                [](const PacketIndex& index, uint64_t pos) {
+                    return index.position < pos;
+                });
+
+                if(i != m_indexList.end() && i->position == position) {
+                    compacted->addIndex({(uint64_t)compacted->getLength(), i->wallclockTime.count(), i->pts});
+                }
+            }
+
+            compacted->write(p);
+        }
+
+        delete p;
+        offset += packetLength;
     }
 
-    // read packet from storage
-    auto p = MsgPacket::read(m_readFd, 1000);
+    compacted->truncate();
+    TimeShiftScheduler::instance().sync(compacted);
+
+    // map an old position to the position of the next remaining packet
+    uint64_t start = segment->getStart();
+    uint64_t end = segment->getEnd();
+
+    auto mapPosition = [&](uint64_t position) -> uint64_t {
+        auto i = std::lower_bound(offsets.begin(), offsets.end(), (off_t)(position - start),
+        [](const std::pair<off_t, off_t>& o, off_t pos) {
+            return o.first < pos;
+        });
+
+        return start + (i != offsets.end() ? i->second : compacted->getLength());
+    };
+
+    // replace segment
+    {
+        std::lock_guard<std::mutex> lock(m_mutexQueue);
+        std::lock_guard<std::mutex> lockIndex(m_mutexIndex);
+        std::lock_guard<std::mutex> lockSegments(m_mutexSegments);
+
+        auto i = std::find(m_segments.begin(), m_segments.end(), segment);
+
+        if(i == m_segments.end() || !compacted->replace(*segment)) {
+            return false;
+        }
 
-    // do not cache the packet anymore
-    if(p != nullptr) {
-        posix_fadvise(m_readFd, readPosition, p->getPacketLength(), POSIX_FADV_DONTNEED);
+        *i = compacted;
+
+        for(auto& index: m_indexList) {
+            if(index.position >= start && index.position < end) {
+                index.position = mapPosition(index.position);
+            }
+        }
+
+        for(auto reader: m_readers) {
+            uint64_t position = reader->m_position.load();
+
+            if(reader->m_timeShift && !reader->m_waiting && position >= start && position < end) {
+                reader->m_position = mapPosition(position);
+            }
+        }
     }
 
-    return p;
+    m_bytesCompacted += segment->getLength() - compacted->getLength();
+
+    dsyslog("compacted timeshift segment %s (%li -> %li bytes)", segment->getName().c_str(), segment->getLength(), compacted->getLength());
+    return true;
 }
 
-bool LiveQueue::isPaused() {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    return m_pause;
+void LiveQueue::setDroppableStreams(const std::set<uint16_t>& pids) {
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
+    m_droppableStreams = pids;
 }
 
-void LiveQueue::queue(MsgPacket* p, StreamInfo::Content content, int64_t pts) {
-    start();
+void LiveQueue::attach(LiveQueueReader* reader) {
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
+
+    m_readers.push_back(reader);
+
+    // late joiners need the current stream information
+    if(m_streamInfo) {
+        reader->m_pending.push_back(m_streamInfo);
+    }
+
+    // and start with the last keyframe
+    reader->m_pending.insert(reader->m_pending.end(), m_gopCache.begin(), m_gopCache.end());
+
+    if(!m_timeShiftOnDemand) {
+        startTimeShift(reader);
+    }
+
+    isyslog("reader attached to live queue %i (%lu readers)", m_id, m_readers.size());
+}
+
+void LiveQueue::detach(LiveQueueReader* reader) {
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
+
+    m_readers.remove(reader);
+
+    isyslog("reader detached from live queue %i (%lu readers)", m_id, m_readers.size());
+}
+
+void LiveQueue::startTimeShift(LiveQueueReader* reader) {
+    // m_mutexQueue must be locked by the caller
+
+    if(reader->m_timeShift) {
+        return;
+    }
+
+    if(!m_timeShift) {
+        isyslog("starting timeshift buffer");
+        m_timeShift = true;
+    }
+
+    // continue reading from the timeshift buffer with the next packet
+    reader->m_timeShift = true;
+    reader->m_waiting = true;
+    reader->m_waitSequence = m_sequence;
+}
+
+void LiveQueue::setReadPosition(LiveQueueReader* reader, uint64_t position) {
+    // m_mutexQueue must be locked by the caller
+    reader->m_position = position;
+    reader->m_waiting = false;
+}
 
+std::shared_ptr<MsgPacket> LiveQueue::read(LiveQueueReader* reader) {
     {
         std::lock_guard<std::mutex> lock(m_mutexQueue);
 
-        if (m_writerQueue.size() >= 400) {
+        if(reader->m_pause) {
+            return nullptr;
+        }
+
+        // serve packets from memory
+        if(!reader->m_pending.empty()) {
+            auto p = reader->m_pending.front();
+            reader->m_pending.pop_front();
+            return p;
+        }
+
+        // arm the notification before looking at the timeshift buffer,
+        // so a packet arriving in the meantime isn't missed
+        reader->m_notifyArmed = true;
+
+        if(!reader->m_timeShift || reader->m_waiting) {
+            return nullptr;
+        }
+    }
+
+    return internalRead(reader);
+}
+
+std::shared_ptr<MsgPacket> LiveQueue::internalRead(LiveQueueReader* reader) {
+    for(;;) {
+        uint64_t position = reader->m_position.load();
+
+        // try memory tier first
+        bool inMemory = false;
+        auto packet = readMemory(position, inMemory);
+
+        if(inMemory) {
+            if(packet == nullptr) {
+                return nullptr;
+            }
+
+            if(!reader->m_position.compare_exchange_strong(position, position + packet->getPacketLength())) {
+                continue;
+            }
+
+            return packet;
+        }
+
+        auto segment = findSegment(position);
+
+        if(segment == nullptr) {
+            return nullptr;
+        }
+
+        // segment already removed -> continue with the oldest one
+        if(position < segment->getStart()) {
+            reader->m_position.compare_exchange_strong(position, segment->getStart());
+            continue;
+        }
+
+        // check if read position is still behind write position
+        off_t offset = (off_t)(position - segment->getStart());
+
+        if(offset >= segment->getLength()) {
+            return nullptr;
+        }
+
+        // read packet from storage
+        MsgPacket* p = segment->read(offset);
+
+        if(p == nullptr) {
+            esyslog("invalid packet in timeshift segment - skipping to write position");
+            reader->m_position.compare_exchange_strong(position, m_writePosition.load());
+            return nullptr;
+        }
+
+        // advance read position
+        // (the write thread may have moved us forward in the meantime)
+        if(!reader->m_position.compare_exchange_strong(position, position + p->getPacketLength())) {
             delete p;
-            return;
+            continue;
         }
 
-        m_writerQueue.push_back({p, content, pts});
+        return std::shared_ptr<MsgPacket>(p);
     }
 }
 
-bool LiveQueue::write(const PacketData& data) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+std::shared_ptr<MsgPacket> LiveQueue::readMemory(uint64_t position, bool& inMemory) {
+    std::lock_guard<std::mutex> lock(m_mutexMemory);
 
-    auto timeStamp = roboTV::currentTimeMillis();
-    auto p = data.p;
-    auto content = data.content;
-    auto pts = data.pts;
+    // reached write position
+    if(position >= m_writePosition.load()) {
+        inMemory = true;
+        return nullptr;
+    }
 
+    if(m_memory.empty() || position < m_memory.front().position) {
+        inMemory = false;
+        return nullptr;
+    }
 
-    // first packet set start time
-    if(m_indexList.empty()) {
-        m_queueStartTime = roboTV::currentTimeMillis();
+    auto i = std::lower_bound(m_memory.begin(), m_memory.end(), position,
+    [](const MemoryPacket& packet, uint64_t pos) {
+        return packet.position < pos;
+    });
+
+    // not at a packet boundary (shouldn't happen)
+    if(i == m_memory.end() || i->position != position) {
+        inMemory = false;
+        return nullptr;
     }
 
-    // ring-buffer overrun ?
+    inMemory = true;
+    return i->p;
+}
+
+void LiveQueue::queue(MsgPacket* p, StreamInfo::Content content, int64_t pts) {
+    // packets are shared between all readers
+    p->freeze();
+    std::shared_ptr<MsgPacket> packet(p);
+
+    uint64_t sequence = 0;
 
-    off_t writePosition = lseek(m_writeFd, 0, SEEK_CUR);
+    {
+        std::lock_guard<std::mutex> lock(m_mutexQueue);
 
-    if(writePosition >= (off_t) m_bufferSize) {
-        isyslog("timeshift: write buffer wrap");
-        int rc = ftruncate(m_writeFd, (off_t)writePosition);
+        sequence = m_sequence++;
 
-        if(rc == -1) {
-            esyslog("truncating the timeshift buffer failed: %i - %s", errno, strerror(errno));
+        if(content == StreamInfo::Content::STREAMINFO) {
+            m_streamInfo = packet;
         }
 
-        lseek(m_writeFd, 0, SEEK_SET);
-        writePosition = 0;
+        updateGopCache(packet, content);
+
+        // distribute packet to all live readers
+        for(auto reader: m_readers) {
+            if(reader->m_timeShift) {
+                continue;
+            }
+
+            reader->m_pending.push_back(packet);
+            reader->notify();
 
-        m_wrapped = !m_wrapped;
-        m_hasWrapped = true;
-        m_wrapCount++;
+            // client can't keep up with the live stream
+            // -> continue in the timeshift buffer
+            if(reader->m_pending.size() >= LIVEWINDOW_MAXPACKETS) {
+                isyslog("live window overflow - continue in timeshift buffer");
+                startTimeShift(reader);
+            }
+        }
 
-        isyslog("wrapped: %s", m_wrapped ? "yes" : "no");
+        if(!m_timeShift) {
+            return;
+        }
     }
 
-    off_t packetEndPosition = writePosition + p->getPacketLength();
-    off_t readPosition = lseek(m_readFd, 0, SEEK_CUR);
+    start();
 
-    // check if write position is still behind read position (if wrapped)
-    // if not -> discard packet
+    // skip non-reference frames if the disk can't keep up
+    // (or the timeshift bandwidth is exhausted)
+    bool nonReference = (p->getClientID() == (uint16_t)StreamInfo::FrameType::BFRAME);
+    bool budget = TimeShiftScheduler::instance().consumeBandwidth(p->getPacketLength(), nonReference);
 
-    while(packetEndPosition >= readPosition && m_wrapped) {
-        esyslog("write overlap - wrapped read position behind write position !");
-        delete p;
-        return false;
+    if(nonReference && (!budget || m_writerQueue.size() >= WRITERQUEUE_HIGHWATER)) {
+        if(m_nonReferenceDropped++ % 100 == 0) {
+            esyslog("timeshift writer too slow - skipped %lu non-reference frames", (uint64_t)m_nonReferenceDropped);
+        }
+        return;
     }
 
-    trim(packetEndPosition);
+    if(!m_writerQueue.push({packet, content, pts, sequence})) {
+        if(m_packetsDropped++ % 100 == 0) {
+            esyslog("timeshift writer queue full - dropped %lu packets", (uint64_t)m_packetsDropped);
+        }
+        return;
+    }
 
-    // add keyframe to map
-    bool keyFrame = (p->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME);
+    // wakeup write thread
+    std::atomic_thread_fence(std::memory_order_seq_cst);
 
-    if(keyFrame && content == StreamInfo::Content::VIDEO) {
-        m_indexList.push_back({writePosition, timeStamp, pts, m_wrapCount});
+    if(m_writerWaiting) {
+        std::lock_guard<std::mutex> lock(m_writerMutex);
+        m_writerCondition.notify_one();
     }
+}
 
-    // write packet
-    bool success = p->write(m_writeFd, 1000);
+void LiveQueue::updateGopCache(const std::shared_ptr<MsgPacket>& packet, StreamInfo::Content content) {
+    // m_mutexQueue must be locked by the caller
 
-    if(!success) {
-        esyslog("Unable to write packet into timeshift ringbuffer !");
+    // new streams -> wait for the next keyframe
+    if(content == StreamInfo::Content::STREAMINFO) {
+        m_gopCache.clear();
+        m_gopCacheSize = 0;
+        return;
     }
 
-    // sync every 2 seconds
-    // we just want to avoid delays of the write-back cache hitting
-    // us on buffer-wrap (or any other occasion)
+    // a new GOP starts with a keyframe
+    if(content == StreamInfo::Content::VIDEO && packet->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME) {
+        m_gopCache.clear();
+        m_gopCacheSize = 0;
+    }
+    else if(m_gopCache.empty()) {
+        return;
+    }
 
-    std::chrono::milliseconds now = roboTV::currentTimeMillis();
+    m_gopCache.push_back(packet);
+    m_gopCacheSize += packet->getPacketLength();
+
+    // GOP too long -> don't cache
+    if(m_gopCache.size() > GOPCACHE_MAXPACKETS || m_gopCacheSize > GOPCACHE_MAXSIZE) {
+        m_gopCache.clear();
+        m_gopCacheSize = 0;
+    }
+}
+
+void LiveQueue::append(const PacketData& data) {
+    auto timeStamp = roboTV::currentTimeMillis();
+    auto p = data.p;
+    uint64_t position = m_writePosition.load();
+
+    // add packet to the memory tier
+    {
+        std::lock_guard<std::mutex> lock(m_mutexMemory);
+
+        m_memory.push_back({p, data.content, data.pts, position, timeStamp});
+        m_memorySize += p->getAllocatedLength();
+
+        // publish packet
+        m_writePosition = position + p->getPacketLength();
+    }
+
+    // add keyframe to index
+    bool keyFrame = (p->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME);
 
-    if(now - m_lastSyncTime >= std::chrono::milliseconds(2000)) {
-        if(fdatasync(m_writeFd) != 0) {
-            esyslog("Failed to sync timeshift ring-buffer !");
+    if(keyFrame && data.content == StreamInfo::Content::VIDEO) {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
+
+        // first packet set start time
+        if(m_indexList.empty()) {
+            m_queueStartTime = timeStamp;
         }
 
-        m_lastSyncTime = now;
+        m_indexList.push_back({position, timeStamp, data.pts});
     }
 
-    delete p;
-    return success;
-}
+    // waiting readers continue with this packet
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
 
-void LiveQueue::close() {
-    ::close(m_readFd);
-    ::close(m_writeFd);
+    for(auto reader: m_readers) {
+        if(reader->m_timeShift && reader->m_waiting && data.sequence >= reader->m_waitSequence) {
+            setReadPosition(reader, position);
+        }
 
-    if(*m_storage) {
-        unlink(m_storage);
+        if(reader->m_timeShift && !reader->m_waiting) {
+            reader->notify();
+        }
     }
 }
 
-void LiveQueue::trim(off_t position) {
-    if(!m_hasWrapped || m_indexList.empty()) {
-        return;
+void LiveQueue::spill(bool all) {
+    std::chrono::milliseconds now = roboTV::currentTimeMillis();
+
+    for(;;) {
+        MemoryPacket packet;
+
+        // packets are only removed by the write thread
+        {
+            std::lock_guard<std::mutex> lock(m_mutexMemory);
+
+            if(m_memory.empty()) {
+                return;
+            }
+
+            packet = m_memory.front();
+            bool aged = (m_memorySize > m_maxMemorySize || now - packet.wallclockTime >= std::chrono::seconds(m_maxMemoryTime));
+
+            if(!all && !aged) {
+                return;
+            }
+        }
+
+        // write to disk before the packet leaves memory
+        write(packet);
+
+        std::lock_guard<std::mutex> lock(m_mutexMemory);
+
+        m_memory.pop_front();
+        m_memorySize -= packet.p->getAllocatedLength();
     }
+}
 
-    auto p = m_indexList.front();
+bool LiveQueue::write(const MemoryPacket& packet) {
+    auto p = packet.p;
+    off_t packetLength = p->getPacketLength();
 
-    if(p.filePosition < position && p.wrapCount < m_wrapCount) {
-        m_indexList.pop_front();
+    if(packetLength > m_segmentSize) {
+        esyslog("packet too large for timeshift segment !");
+        return false;
     }
 
-    if(!m_indexList.empty()) {
-        p = m_indexList.front();
-        m_queueStartTime = p.wallclockTime;
+    // segments are only added by the write thread
+    std::shared_ptr<TimeShiftSegment> segment = m_segments.empty() ? nullptr : m_segments.back();
+
+    // start a new segment (or after lost packets)
+    if(segment == nullptr || !segment->fits(packetLength) || segment->getEnd() != packet.position) {
+        segment = createSegment(packet.position);
     }
-}
 
-bool LiveQueue::pause(bool on) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    if(segment == nullptr) {
+        return false;
+    }
 
-    if(m_pause == on) {
+    // write packet
+    if(!segment->write(p.get())) {
+        esyslog("Unable to write packet into timeshift segment !");
         return false;
     }
 
-    m_pause = on;
+    m_packetsWritten++;
+
+    // add keyframe to segment index
+    bool keyFrame = (p->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME);
+
+    if(keyFrame && packet.content == StreamInfo::Content::VIDEO) {
+        segment->addIndex({packet.position - segment->getStart(), packet.wallclockTime.count(), packet.pts});
+    }
+
+    // start writeback of completed blocks
+    // we just want to avoid delays of the write-back cache hitting
+    // us on segment change (or any other occasion)
+    off_t from = 0;
+    off_t to = 0;
+
+    if(segment->nextWriteback(from, to)) {
+        TimeShiftScheduler::instance().writeback(segment, from, to);
+    }
+
     return true;
 }
 
-void LiveQueue::setTimeShiftDir(const cString& dir) {
-    m_timeShiftDir = dir;
-    dsyslog("TIMESHIFTDIR: %s", m_timeShiftDir.c_str());
+void LiveQueue::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutexSegments);
+
+        // keep segments for reconnecting clients
+        if(m_keepStorage) {
+            for(auto& segment: m_segments) {
+                segment->seal();
+            }
+        }
+
+        m_segments.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(m_storageMutex);
+
+    if(!m_keepStorage) {
+        return;
+    }
+
+    m_storageInUse.erase(m_storageName);
+
+    if(m_writePosition > 0) {
+        m_detachedStorage[m_storageName] = roboTV::currentTimeMillis();
+    }
 }
 
-void LiveQueue::setBufferSize(uint64_t s) {
-    m_bufferSize = s;
-    isyslog("timeshift buffersize: %lu bytes", m_bufferSize);
+void LiveQueue::skipReaders(uint64_t position) {
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
+
+    for(auto reader: m_readers) {
+        if(!reader->m_timeShift || reader->m_waiting) {
+            continue;
+        }
+
+        if(reader->m_position.load() >= position) {
+            continue;
+        }
+
+        // reader would loose it's segment -> skip to the next keyframe
+        esyslog("timeshift segment removed - skipping reader to next keyframe");
+
+        uint64_t nextPosition = position;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutexIndex);
+
+            if(!m_indexList.empty()) {
+                nextPosition = std::max(position, m_indexList.front().position);
+            }
+        }
+
+        // the reader thread will notice the changed position
+        reader->m_position = nextPosition;
+    }
 }
 
-void LiveQueue::removeTimeShiftFiles() {
-    DIR* dir = opendir(m_timeShiftDir.c_str());
+void LiveQueue::trim(uint64_t maxSize, uint64_t endPosition) {
+    uint64_t startPosition = endPosition;
 
-    if(dir == nullptr) {
-        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexSegments);
+
+        // remove the oldest segments
+        // (compacted segments are smaller than the range they cover)
+        uint64_t size = 0;
+
+        for(auto& segment: m_segments) {
+            size += segment->getLength();
+        }
+
+        while(!m_segments.empty() && size > maxSize) {
+            size -= m_segments.front()->getLength();
+            m_segments.pop_front();
+        }
+
+        if(!m_segments.empty()) {
+            startPosition = m_segments.front()->getStart();
+        }
     }
 
-    struct dirent* entry = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexIndex);
 
-    while((entry = readdir(dir)) != nullptr) {
-        if(strncmp(entry->d_name, "robotv-ringbuffer-", 16) == 0) {
-            isyslog("Removing old time-shift storage: %s", entry->d_name);
-            unlink(AddDirectory(m_timeShiftDir.c_str(), entry->d_name));
+        while(!m_indexList.empty() && m_indexList.front().position < startPosition) {
+            m_indexList.pop_front();
+        }
+
+        if(!m_indexList.empty()) {
+            m_queueStartTime = m_indexList.front().wallclockTime;
         }
     }
 
-    closedir(dir);
+    skipReaders(startPosition);
+}
+
+void LiveQueue::setTimeShiftOnDemand(bool on) {
+    m_timeShiftOnDemand = on;
+    isyslog("timeshift on demand: %s", on ? "yes" : "no");
+}
+
+void LiveQueue::setMemorySize(uint64_t size) {
+    m_maxMemorySize = size;
+    isyslog("timeshift memory size: %lu bytes", m_maxMemorySize);
+}
+
+void LiveQueue::setMemoryTime(int seconds) {
+    m_maxMemoryTime = seconds;
+    isyslog("timeshift memory time: %i seconds", m_maxMemoryTime);
+}
+
+void LiveQueue::setCompactionAge(int seconds) {
+    m_compactionAge = seconds;
+    isyslog("timeshift compaction after: %i seconds", m_compactionAge);
+}
+
+void LiveQueue::removeTimeShiftFiles() {
+    TimeShiftScheduler::instance().removeFiles(TIMESHIFT_PREFIX);
 }
 
-int64_t LiveQueue::seek(int64_t wallclockPositionMs) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+int64_t LiveQueue::seek(LiveQueueReader* reader, int64_t wallclockPositionMs) {
+    std::lock_guard<std::mutex> lock(m_mutexQueue);
+    std::lock_guard<std::mutex> lockIndex(m_mutexIndex);
 
     isyslog("seek: %lu", wallclockPositionMs);
 
-    auto s = m_indexList.rbegin();
-    auto e = m_indexList.rend();
-    auto h = m_indexList.begin();
+    startTimeShift(reader);
 
-    if(s == e) {
+    if(m_indexList.empty()) {
         esyslog("empty timeshift queue - unable to seek");
         return 0;
     }
 
-    // ahead of buffer
-    if(wallclockPositionMs >= s->wallclockTime.count()) {
-        lseek(m_readFd, s->filePosition, SEEK_SET);
-        return s->pts;
+    // drop packets waiting in memory
+    reader->m_pending.clear();
+
+    // first keyframe after the requested position
+    auto i = std::upper_bound(m_indexList.begin(), m_indexList.end(), wallclockPositionMs,
+    [](int64_t pos, const PacketIndex& index) {
+        return pos < index.wallclockTime.count();
+    });
+
+    // continue with the keyframe before (or the first one if we are behind the buffer)
+    if(i != m_indexList.begin()) {
+        i--;
     }
 
-    // behind buffer
-    else if(wallclockPositionMs <= h->wallclockTime.count()) {
-        lseek(m_readFd, h->filePosition, SEEK_SET);
-        return h->pts;
+    setReadPosition(reader, i->position);
+    return i->pts;
+}
+
+int64_t LiveQueue::getTimeshiftStartPosition() {
+    // no timeshift buffer (yet)
+    if(!m_timeShift) {
+        return roboTV::currentTimeMillis().count();
     }
 
-    // in between ?
-    while(s != e) {
-        if(s->wallclockTime.count() <= wallclockPositionMs) {
-            lseek(m_readFd, s->filePosition, SEEK_SET);
-            return s->pts;
-        }
+    std::lock_guard<std::mutex> lock(m_mutexIndex);
+    return m_queueStartTime.count();
+}
+
+LiveQueue::Statistics LiveQueue::getStatistics() {
+    Statistics s{};
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutexQueue);
+        s.readers = m_readers.size();
+    }
 
-        s++;
+    {
+        std::lock_guard<std::mutex> lock(m_mutexMemory);
+        s.memorySize = m_memorySize;
     }
 
-    // not found
-    esyslog("fileposition not found!");
-    return 0;
+    s.bytesCompacted = m_bytesCompacted;
+    s.timeShift = m_timeShift;
+    s.packetsWritten = m_packetsWritten;
+    s.packetsDropped = m_packetsDropped;
+    s.nonReferenceDropped = m_nonReferenceDropped;
+
+    return s;
 }
 
-int64_t LiveQueue::getTimeshiftStartPosition() {
-    return m_queueStartTime.count();
+LiveQueueReader::LiveQueueReader(LiveQueue* queue) : m_queue(queue), m_notifyArmed(false), m_pause(false), m_timeShift(false),
+    m_position(0), m_waiting(false), m_waitSequence(0) {
+    m_queue->attach(this);
+}
+
+LiveQueueReader::~LiveQueueReader() {
+    m_queue->detach(this);
+}
+
+void LiveQueueReader::queue(MsgPacket* p) {
+    std::lock_guard<std::mutex> lock(m_queue->m_mutexQueue);
+    m_pending.push_back(std::shared_ptr<MsgPacket>(p));
+    notify();
+}
+
+void LiveQueueReader::setNotify(std::function<void()> notify) {
+    std::lock_guard<std::mutex> lock(m_queue->m_mutexQueue);
+    m_notify = notify;
+    m_notifyArmed = true;
+}
+
+void LiveQueueReader::notify() {
+    // m_mutexQueue must be locked by the caller
+
+    if(!m_notifyArmed || !m_notify) {
+        return;
+    }
+
+    m_notifyArmed = false;
+    m_notify();
+}
+
+std::shared_ptr<MsgPacket> LiveQueueReader::read() {
+    return m_queue->read(this);
+}
+
+int64_t LiveQueueReader::seek(int64_t wallclockPositionMs) {
+    return m_queue->seek(this, wallclockPositionMs);
+}
+
+bool LiveQueueReader::pause(bool on) {
+    std::lock_guard<std::mutex> lock(m_queue->m_mutexQueue);
+
+    if(m_pause == on) {
+        return false;
+    }
+
+    // we need the timeshift buffer from now on
+    if(on) {
+        m_queue->startTimeShift(this);
+    }
+
+    m_pause = on;
+
+    // wake up the client to continue pushing packets
+    if(!on) {
+        m_notifyArmed = true;
+        notify();
+    }
+
+    return true;
+}
+
+bool LiveQueueReader::isPaused() {
+    std::lock_guard<std::mutex> lock(m_queue->m_mutexQueue);
+    return m_pause;
+}
+
+int64_t LiveQueueReader::getTimeshiftStartPosition() {
+    return m_queue->getTimeshiftStartPosition();
 }
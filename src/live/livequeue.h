@@ -31,90 +31,189 @@
 #include <chrono>
 #include <mutex>
 #include <list>
+#include <map>
+#include <set>
+#include <string>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <functional>
+#include <condition_variable>
+
+#include "tools/spscqueue.h"
+#include "timeshiftsegment.h"
 
 class MsgPacket;
+class LiveQueueReader;
 
+/**
+ * Shared live queue.
+ * Holds the timeshift storage of a live stream and distributes the packets
+ * of the stream to all connected readers.
+ *
+ * The timeshift storage consists of a memory tier holding the most recent
+ * packets and a list of fixed-size segment files (each with a keyframe index
+ * sidecar). Packets are written to disk when they age out of memory.
+ * Positions are absolute byte offsets in the stream, so the write head and
+ * the read cursors can be updated atomically without locking.
+ * The storage of a channel is kept for a while after the last reader detached,
+ * a reconnecting client continues with the previous timeshift buffer.
+ */
 class LiveQueue {
+    friend class LiveQueueReader;
 public:
 
-    LiveQueue(int socket);
+    LiveQueue(int id, uint32_t channelUid);
 
     virtual ~LiveQueue();
 
     void queue(MsgPacket* p, StreamInfo::Content content, int64_t pts = 0);
 
-    MsgPacket* read();
+    static void setTimeShiftOnDemand(bool on);
 
-    int64_t seek(int64_t wallclockPositionMs);
+    static void setMemorySize(uint64_t size);
 
-    bool pause(bool on = true);
+    static void setMemoryTime(int seconds);
 
-    bool isPaused();
+    static void setCompactionAge(int seconds);
 
-    static void setTimeShiftDir(const cString& dir);
-
-    static void setBufferSize(uint64_t s);
+    /**
+     * Set streams which may be removed from old parts of the timeshift buffer.
+     * @param pids pids of the streams (e.g. secondary audio tracks)
+     */
+    void setDroppableStreams(const std::set<uint16_t>& pids);
 
     static void removeTimeShiftFiles();
 
     int64_t getTimeshiftStartPosition();
 
+    struct Statistics {
+        size_t readers;
+        bool timeShift;
+        uint64_t memorySize;
+        uint64_t bytesCompacted;
+        uint64_t packetsWritten;
+        uint64_t packetsDropped;
+        uint64_t nonReferenceDropped;
+    };
+
+    Statistics getStatistics();
+
     struct PacketData {
-        MsgPacket* p;
+        std::shared_ptr<MsgPacket> p;
         StreamInfo::Content content;
         int64_t pts;
+        uint64_t sequence;
     };
 
 protected:
 
+    struct MemoryPacket {
+        std::shared_ptr<MsgPacket> p;
+        StreamInfo::Content content;
+        int64_t pts;
+        uint64_t position;
+        std::chrono::milliseconds wallclockTime;
+    };
+
     struct PacketIndex {
-        off_t filePosition;
+        uint64_t position;
         std::chrono::milliseconds wallclockTime;
         int64_t pts;
-        int wrapCount;
     };
 
-    bool write(const PacketData& data);
+    void updateGopCache(const std::shared_ptr<MsgPacket>& packet, StreamInfo::Content content);
+
+    void append(const PacketData& data);
+
+    void spill(bool all);
+
+    bool write(const MemoryPacket& packet);
 
     void start();
 
-    void createRingBuffer();
+    void startTimeShift(LiveQueueReader* reader);
+
+    void loadStorage();
+
+    std::shared_ptr<TimeShiftSegment> createSegment(uint64_t start);
+
+    std::shared_ptr<TimeShiftSegment> findSegment(uint64_t position);
+
+    void compact();
+
+    bool compactSegment(const std::shared_ptr<TimeShiftSegment>& segment);
 
     void close();
 
-    void trim(off_t position);
+    void trim(uint64_t maxSize, uint64_t endPosition);
+
+    void skipReaders(uint64_t position);
+
+    void setReadPosition(LiveQueueReader* reader, uint64_t position);
+
+    void attach(LiveQueueReader* reader);
 
-    MsgPacket* internalRead();
+    void detach(LiveQueueReader* reader);
 
-    void seekNextKeyFrame();
+    std::shared_ptr<MsgPacket> read(LiveQueueReader* reader);
+
+    std::shared_ptr<MsgPacket> internalRead(LiveQueueReader* reader);
+
+    std::shared_ptr<MsgPacket> readMemory(uint64_t position, bool& inMemory);
+
+    int64_t seek(LiveQueueReader* reader, int64_t wallclockPositionMs);
 
     std::deque<struct PacketIndex> m_indexList;
 
-    int m_readFd;
+    std::mutex m_mutexIndex;
 
-    int m_writeFd;
+    int m_id;
 
-    int m_socket;
+    // memory tier (oldest first)
+    std::deque<MemoryPacket> m_memory;
 
-    bool m_pause;
+    std::mutex m_mutexMemory;
+
+    // allocated memory of the packets in the memory tier
+    uint64_t m_memorySize;
 
-    std::mutex m_mutex;
+    // timeshift segments (oldest first)
+    std::deque<std::shared_ptr<TimeShiftSegment>> m_segments;
 
-    cString m_storage;
+    std::mutex m_mutexSegments;
 
+    // name of the timeshift storage (segment filename prefix)
+    std::string m_storageName;
+
+    // keep the storage for reconnecting clients
+    bool m_keepStorage;
+
+    off_t m_segmentSize;
+
+    uint64_t m_segmentNumber;
+
+    // wallclock time of the first keyframe (locked by m_mutexIndex)
     std::chrono::milliseconds m_queueStartTime;
 
-    bool m_wrapped;
+    // write head (stream position)
+    std::atomic<uint64_t> m_writePosition;
+
+    static std::mutex m_storageMutex;
 
-    bool m_hasWrapped;
+    // storages of running queues
+    static std::set<std::string> m_storageInUse;
 
-    int m_wrapCount;
+    // storages kept for reconnecting clients (name -> detach time)
+    static std::map<std::string, std::chrono::milliseconds> m_detachedStorage;
 
-    static std::string m_timeShiftDir;
+    static bool m_timeShiftOnDemand;
 
-    static uint64_t m_bufferSize;
+    static uint64_t m_maxMemorySize;
+
+    static int m_maxMemoryTime;
+
+    static int m_compactionAge;
 
 private:
 
@@ -122,12 +221,108 @@ private:
 
     std::atomic<bool> m_writerRunning;
 
-    std::chrono::milliseconds m_lastSyncTime;
+    // packets waiting to be written (producer: receiver, consumer: write thread)
+    roboTV::SpscQueue<PacketData, 512> m_writerQueue;
+
+    std::mutex m_writerMutex;
+
+    std::condition_variable m_writerCondition;
+
+    std::atomic<bool> m_writerWaiting;
 
-    std::deque<PacketData> m_writerQueue;
+    std::atomic<uint64_t> m_packetsWritten;
+
+    std::atomic<uint64_t> m_packetsDropped;
+
+    std::atomic<uint64_t> m_nonReferenceDropped;
+
+    std::atomic<uint64_t> m_bytesCompacted;
+
+    std::set<uint16_t> m_droppableStreams;
 
     std::mutex m_mutexQueue;
 
+    std::list<LiveQueueReader*> m_readers;
+
+    // last stream information packet (for new readers)
+    std::shared_ptr<MsgPacket> m_streamInfo;
+
+    // packets since the last keyframe (for new readers)
+    std::deque<std::shared_ptr<MsgPacket>> m_gopCache;
+
+    uint64_t m_gopCacheSize;
+
+    // sequence number of the next packet
+    uint64_t m_sequence;
+
+    std::atomic<bool> m_timeShift;
+
+};
+
+/**
+ * Reader of a shared live queue.
+ * Every client has it's own read position (cursor) in the live queue.
+ * In live mode packets are served from memory, after a pause or seek the
+ * reader continues in the timeshift storage of the queue.
+ */
+class LiveQueueReader {
+    friend class LiveQueue;
+public:
+
+    LiveQueueReader(LiveQueue* queue);
+
+    virtual ~LiveQueueReader();
+
+    /**
+     * Queue a private packet.
+     * The packet will only be delivered to this reader.
+     * @param p pointer to packet (ownership is transferred)
+     */
+    void queue(MsgPacket* p);
+
+    std::shared_ptr<MsgPacket> read();
+
+    int64_t seek(int64_t wallclockPositionMs);
+
+    bool pause(bool on = true);
+
+    bool isPaused();
+
+    int64_t getTimeshiftStartPosition();
+
+    /**
+     * Set data notification.
+     * The callback is invoked (with the queue locked) when new data arrives
+     * after a read came up empty. It must not block or call into the queue.
+     * @param notify callback function
+     */
+    void setNotify(std::function<void()> notify);
+
+private:
+
+    void notify();
+
+    LiveQueue* m_queue;
+
+    std::function<void()> m_notify;
+
+    // reader ran out of data and waits for a notification
+    bool m_notifyArmed;
+
+    // packets waiting to be sent from memory
+    std::deque<std::shared_ptr<MsgPacket>> m_pending;
+
+    bool m_pause;
+
+    bool m_timeShift;
+
+    // timeshift read position (stream position)
+    std::atomic<uint64_t> m_position;
+
+    bool m_waiting;
+
+    uint64_t m_waitSequence;
+
 };
 
 #endif // ROBOTV_LIVEQUEUE_H
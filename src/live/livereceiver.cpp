@@ -0,0 +1,573 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <vdr/remux.h>
+
+#include "config/config.h"
+#include "net/msgpacket.h"
+#include "robotv/robotvcommand.h"
+#include "tools/hash.h"
+#include "tools/time.h"
+
+#include "livereceiver.h"
+#include "channelcache.h"
+
+std::list<LiveReceiver*> LiveReceiver::m_receivers;
+std::mutex LiveReceiver::m_receiversMutex;
+int LiveReceiver::m_receiverId = 0;
+bool LiveReceiver::m_fastStart = false;
+
+LiveReceiver::LiveReceiver(uint32_t uid, int priority, const std::string& language, StreamInfo::Type streamType)
+    : cReceiver(nullptr, priority)
+    , m_language(language)
+    , m_langStreamType(streamType)
+    , m_uid(uid)
+    , m_holders({ priority })
+    , m_selectionChanged(false) {
+    // create shared queue
+    m_queue = new LiveQueue(++m_receiverId, uid);
+}
+
+LiveReceiver::~LiveReceiver() {
+    cDevice * device = Device();
+
+    if(device != nullptr) {
+        cCamSlot *camSlot = device->CamSlot();
+
+        if (camSlot != nullptr) {
+            isyslog("camslot detached");
+            ChannelCamRelations.ClrChecked(ChannelID(), camSlot->SlotNumber());
+        }
+
+        Detach();
+    }
+
+    reset();
+    delete m_queue;
+
+    isyslog("live receiver terminated");
+}
+
+LiveReceiver* LiveReceiver::acquire(const cChannel* channel, int priority, const std::string& language, StreamInfo::Type streamType, int& status) {
+    std::lock_guard<std::mutex> lock(m_receiversMutex);
+
+    if(channel == nullptr) {
+        esyslog("unknown channel !");
+        status = ROBOTV_RET_ERROR;
+        return nullptr;
+    }
+
+    uint32_t uid = roboTV::Hash::createChannelUid(channel);
+
+    // check for a running receiver of this channel
+    for(auto receiver: m_receivers) {
+        if(receiver->m_uid != uid || !receiver->IsAttached()) {
+            continue;
+        }
+
+        if(receiver->m_language != language || receiver->m_langStreamType != streamType) {
+            continue;
+        }
+
+        receiver->m_holders.insert(priority);
+        receiver->SetPriority(*receiver->m_holders.rbegin());
+
+        isyslog("sharing receiver of channel %i - %s (%i clients)", channel->Number(), channel->Name(), (int)receiver->m_holders.size());
+        status = ROBOTV_RET_OK;
+        return receiver;
+    }
+
+    // create new receiver
+    LiveReceiver* receiver = new LiveReceiver(uid, priority, language, streamType);
+    status = receiver->switchChannel(channel);
+
+    if(status != ROBOTV_RET_OK) {
+        delete receiver;
+        return nullptr;
+    }
+
+    m_receivers.push_back(receiver);
+    return receiver;
+}
+
+LiveReceiver* LiveReceiver::preTune(const cChannel* channel, int priority, const std::string& language, StreamInfo::Type streamType) {
+    std::lock_guard<std::mutex> lock(m_receiversMutex);
+
+    uint32_t uid = roboTV::Hash::createChannelUid(channel);
+
+    // channel already received
+    for(auto receiver: m_receivers) {
+        if(receiver->m_uid != uid || !receiver->IsAttached()) {
+            continue;
+        }
+
+        if(receiver->m_language != language || receiver->m_langStreamType != streamType) {
+            continue;
+        }
+
+        receiver->m_holders.insert(priority);
+        receiver->SetPriority(*receiver->m_holders.rbegin());
+        return receiver;
+    }
+
+    // channels of a tuned transponder come for free
+    cDevice* device = findTunedDevice(channel);
+
+    if(device == nullptr) {
+        device = findIdleDevice(channel, priority);
+    }
+
+    if(device == nullptr) {
+        return nullptr;
+    }
+
+    isyslog("pre-tuning channel %i - %s on device %d", channel->Number(), channel->Name(), device->DeviceNumber() + 1);
+
+    LiveReceiver* receiver = new LiveReceiver(uid, priority, language, streamType);
+
+    if(receiver->switchChannel(channel, device) != ROBOTV_RET_OK) {
+        delete receiver;
+        return nullptr;
+    }
+
+    m_receivers.push_back(receiver);
+    return receiver;
+}
+
+cDevice* LiveReceiver::findIdleDevice(const cChannel* channel, int priority) {
+    // encrypted channels would need a CAM
+    if(channel->Ca() >= CA_ENCRYPTED_MIN) {
+        return nullptr;
+    }
+
+    for(int i = 0; i < cDevice::NumDevices(); i++) {
+        cDevice* device = cDevice::GetDevice(i);
+
+        if(device == nullptr || device->Receiving()) {
+            continue;
+        }
+
+        // don't touch the live view of vdr
+        if(device->IsPrimaryDevice() && device->HasDecoder()) {
+            continue;
+        }
+
+        bool needsDetachReceivers = false;
+
+        if(device->ProvidesChannel(channel, priority, &needsDetachReceivers) && !needsDetachReceivers) {
+            return device;
+        }
+    }
+
+    return nullptr;
+}
+
+void LiveReceiver::release(LiveReceiver* receiver, int priority) {
+    std::lock_guard<std::mutex> lock(m_receiversMutex);
+
+    auto i = receiver->m_holders.find(priority);
+
+    if(i != receiver->m_holders.end()) {
+        receiver->m_holders.erase(i);
+    }
+    else if(!receiver->m_holders.empty()) {
+        esyslog("receiver released with unknown priority %i", priority);
+        receiver->m_holders.erase(receiver->m_holders.begin());
+    }
+
+    // still in use, drop to the highest remaining priority
+    if(!receiver->m_holders.empty()) {
+        receiver->SetPriority(*receiver->m_holders.rbegin());
+        return;
+    }
+
+    m_receivers.remove(receiver);
+    delete receiver;
+}
+
+cDevice* LiveReceiver::findTunedDevice(const cChannel* channel) {
+    // decryption of several services needs a capable CAM
+    // -> leave encrypted channels to cDevice::GetDevice
+    if(channel->Ca() >= CA_ENCRYPTED_MIN) {
+        return nullptr;
+    }
+
+    for(int i = 0; i < cDevice::NumDevices(); i++) {
+        cDevice* device = cDevice::GetDevice(i);
+
+        if(device == nullptr || !device->Receiving() || !device->IsTunedToTransponder(channel)) {
+            continue;
+        }
+
+        bool needsDetachReceivers = false;
+
+        if(device->ProvidesChannel(channel, LIVEPRIORITY, &needsDetachReceivers) && !needsDetachReceivers) {
+            return device;
+        }
+    }
+
+    return nullptr;
+}
+
+int LiveReceiver::switchChannel(const cChannel* channel, cDevice* device) {
+    // prefer a device already tuned to the transponder of the channel
+    if(device == nullptr) {
+        device = findTunedDevice(channel);
+    }
+
+    // get device for this channel
+    if(device == nullptr) {
+        device = cDevice::GetDevice(channel, LIVEPRIORITY, false);
+    }
+
+    // maybe an encrypted channel that cannot be handled
+    // lets try if a device can decrypt it on it's own (without a CAM slot)
+    if(device == nullptr) {
+        device = cDevice::GetDeviceForTransponder(channel, LIVEPRIORITY);
+    }
+
+    // maybe all devices busy
+    if(device == nullptr) {
+        esyslog("No device available !");
+        return ROBOTV_RET_DATALOCKED;
+    }
+
+    isyslog("Found available device %d", device->DeviceNumber() + 1);
+
+    if(device->Receiving() && device->IsTunedToTransponder(channel)) {
+        isyslog("sharing transponder with the receivers of device %d", device->DeviceNumber() + 1);
+    }
+    else if(!device->SwitchChannel(channel, false)) {
+        esyslog("Can't switch to channel %i - %s", channel->Number(), channel->Name());
+        return ROBOTV_RET_ERROR;
+    }
+
+    m_uid = roboTV::Hash::createChannelUid(channel);
+
+    StreamBundle currentItem = createFromChannel(channel);
+    m_channelBundle = currentItem;
+
+    // get cached demuxer data
+    ChannelCache &cache = ChannelCache::instance();
+    StreamBundle cacheItem = cache.lookup(m_uid);
+
+    // channel already in cache
+    if (!cacheItem.empty()) {
+        isyslog("Channel information found in cache");
+    }
+    // channel not found in cache -> add it from vdr
+    else {
+        isyslog("adding channel to cache");
+        cacheItem = currentItem;
+        cache.add(m_uid, cacheItem);
+    }
+
+    // recheck cache item
+    if (!currentItem.isMetaOf(cacheItem)) {
+        isyslog("current channel differs from cache item - updating");
+        cacheItem = currentItem;
+        cache.add(m_uid, cacheItem);
+    }
+
+    if(cacheItem.empty()) {
+        esyslog("channel %i - %s doesn't have any stream information", channel->Number(), channel->Name());
+        return ROBOTV_RET_ERROR;
+    }
+
+    isyslog("Creating demuxers");
+    createDemuxers(&cacheItem);
+
+    onStreamChange();
+
+    // send cached stream information (if complete)
+    if(m_fastStart) {
+        fastStart();
+    }
+
+    isyslog("Successfully switched to channel %i - %s", channel->Number(), channel->Name());
+
+    // fool device to not start the decryption timer
+    int priority = Priority();
+    SetPriority(MINPRIORITY);
+
+    /// attach receiver
+    if (device->AttachReceiver(this) == false) {
+        esyslog("failed to attach receiver !");
+        SetPriority(priority);
+        return ROBOTV_RET_ERROR;
+    }
+
+    // start decrypting manually
+    cCamSlot* slot = device->CamSlot();
+
+    if(slot) {
+        slot->StartDecrypting();
+    }
+
+    SetPriority(priority);
+
+    isyslog("done switching.");
+    return ROBOTV_RET_OK;
+}
+
+MsgPacket *LiveReceiver::createStreamChangePacket(DemuxerBundle &bundle) {
+    StreamBundle cache;
+
+    for(auto i = bundle.begin(); i != bundle.end(); i++) {
+        StreamInfo info(*(*i));
+
+        // the stream selection belongs to the clients of this receiver
+        info.setEnabled(true);
+        cache.addStream(info);
+    }
+
+    ChannelCache::instance().add(m_uid, cache);
+
+    // apply stream selection to the (new) demuxers with the next packet
+    {
+        std::lock_guard<std::mutex> lock(m_selectionMutex);
+        m_streamPids.clear();
+
+        for(auto i = bundle.begin(); i != bundle.end(); i++) {
+            m_streamPids.insert((*i)->getPid());
+        }
+
+        m_selectionChanged = true;
+    }
+
+    // reorder streams as preferred
+    bundle.reorderStreams(m_language.c_str(), m_langStreamType);
+
+    // secondary audio tracks may be removed from old parts of the timeshift buffer
+    std::set<uint16_t> droppable;
+    bool primary = true;
+
+    for(auto i = bundle.begin(); i != bundle.end(); i++) {
+        if((*i)->getContent() != StreamInfo::Content::AUDIO) {
+            continue;
+        }
+
+        if(!primary) {
+            droppable.insert((uint16_t)(*i)->getPid());
+        }
+
+        primary = false;
+    }
+
+    m_queue->setDroppableStreams(droppable);
+
+    return StreamPacketProcessor::createStreamChangePacket(bundle);
+}
+
+void LiveReceiver::Receive(const uchar* packet, int length) {
+    if(m_selectionChanged) {
+        updateStreamSelection();
+    }
+
+    // the wallclock is read once for all packets of this block
+    putTsPackets((uint8_t*)packet, length / TS_SIZE, roboTV::currentTimeMillis().count());
+}
+
+std::list<LiveReceiver::Status> LiveReceiver::getStatus() {
+    std::lock_guard<std::mutex> lock(m_receiversMutex);
+    std::list<Status> list;
+
+    for(auto receiver: m_receivers) {
+        list.push_back({
+            receiver->m_uid,
+            (int)receiver->m_holders.size(),
+            receiver->m_language,
+            receiver->m_queue->getStatistics()
+        });
+    }
+
+    return list;
+}
+
+std::set<int> LiveReceiver::selectStreams(uint32_t client, const std::set<int>& pids) {
+    std::lock_guard<std::mutex> lock(m_selectionMutex);
+    std::set<int> deselected;
+
+    if(!pids.empty()) {
+        for(int pid: m_streamPids) {
+            if(pids.find(pid) == pids.end()) {
+                deselected.insert(pid);
+            }
+        }
+    }
+
+    m_deselected[client] = deselected;
+    m_selectionChanged = true;
+
+    return deselected;
+}
+
+void LiveReceiver::removeStreamSelection(uint32_t client) {
+    std::lock_guard<std::mutex> lock(m_selectionMutex);
+
+    m_deselected.erase(client);
+    m_selectionChanged = true;
+}
+
+void LiveReceiver::updateStreamSelection() {
+    // called from the receiver thread
+    std::set<int> disabled;
+
+    {
+        std::lock_guard<std::mutex> lock(m_selectionMutex);
+        m_selectionChanged = false;
+
+        // streams deselected by all clients
+        for(auto i = m_deselected.begin(); i != m_deselected.end(); i++) {
+            if(i == m_deselected.begin()) {
+                disabled = i->second;
+                continue;
+            }
+
+            std::set<int> common;
+
+            for(int pid: i->second) {
+                if(disabled.find(pid) != disabled.end()) {
+                    common.insert(pid);
+                }
+            }
+
+            disabled = common;
+        }
+    }
+
+    for(auto dmx: getDemuxers()) {
+        bool enabled = (disabled.find(dmx->getPid()) == disabled.end());
+
+        if(enabled == dmx->isEnabled()) {
+            continue;
+        }
+
+        isyslog("%s stream %i (%s)", enabled ? "enabling" : "disabling", dmx->getPid(), dmx->typeName());
+
+        // start parsing from scratch
+        if(enabled) {
+            dmx->reset();
+        }
+
+        dmx->setEnabled(enabled);
+    }
+}
+
+void LiveReceiver::setFastStart(bool on) {
+    m_fastStart = on;
+}
+
+void LiveReceiver::processChannelChange(const cChannel* channel) {
+    if(roboTV::Hash::createChannelUid(channel) != m_uid) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // every client of this receiver reports the same change
+    if(createFromChannel(channel) == m_channelBundle) {
+        return;
+    }
+
+    isyslog("ChannelChange()");
+
+    Detach();
+    cleanupQueue(); // remove pre-queued packets
+    switchChannel(channel);
+}
+
+void LiveReceiver::createDemuxers(StreamBundle* bundle) {
+    DemuxerBundle& demuxers = getDemuxers();
+
+    // new channel -> start from scratch
+    demuxers.clear();
+    demuxers.updateFrom(bundle);
+
+    // update pids
+    SetPids(nullptr);
+
+    for(auto i = demuxers.begin(); i != demuxers.end(); i++) {
+        TsDemuxer* dmx = *i;
+        AddPid(dmx->getPid());
+    }
+}
+
+StreamBundle LiveReceiver::createFromChannel(const cChannel* channel) {
+    StreamBundle item;
+
+    // add video stream
+    int vpid = channel->Vpid();
+    int vtype = channel->Vtype();
+
+    item.addStream(StreamInfo(vpid,
+                              vtype == 0x02 ? StreamInfo::Type::MPEG2VIDEO :
+                              vtype == 0x1b ? StreamInfo::Type::H264 :
+                              vtype == 0x24 ? StreamInfo::Type::H265 :
+                              StreamInfo::Type::NONE));
+
+    // add (E)AC3 streams
+    for(int i = 0; channel->Dpid(i) != 0; i++) {
+        int dtype = channel->Dtype(i);
+        item.addStream(StreamInfo(channel->Dpid(i),
+                                  dtype == 0x6A ? StreamInfo::Type::AC3 :
+                                  dtype == 0x7A ? StreamInfo::Type::EAC3 :
+                                  StreamInfo::Type::NONE,
+                                  channel->Dlang(i)));
+    }
+
+    // add audio streams
+    for(int i = 0; channel->Apid(i) != 0; i++) {
+        int atype = channel->Atype(i);
+        item.addStream(StreamInfo(channel->Apid(i),
+                                  atype == 0x04 ? StreamInfo::Type::MPEG2AUDIO :
+                                  atype == 0x03 ? StreamInfo::Type::MPEG2AUDIO :
+                                  atype == 0x0f ? StreamInfo::Type::AAC :
+                                  atype == 0x11 ? StreamInfo::Type::LATM :
+                                  StreamInfo::Type::NONE,
+                                  channel->Alang(i)));
+    }
+
+    // add subtitle streams
+    for(int i = 0; channel->Spid(i) != 0; i++) {
+        StreamInfo stream(channel->Spid(i), StreamInfo::Type::DVBSUB, channel->Slang(i));
+
+        stream.setSubtitlingDescriptor(
+                channel->SubtitlingType(i),
+                channel->CompositionPageId(i),
+                channel->AncillaryPageId(i));
+
+        item.addStream(stream);
+    }
+
+    return item;
+}
+
+int64_t LiveReceiver::getCurrentTime(TsDemuxer::StreamPacket *p) {
+    return p->streamPosition;
+}
+
+void LiveReceiver::onPacket(MsgPacket *p, StreamInfo::Content content, int64_t pts) {
+    m_queue->queue(p, content, pts);
+}
@@ -0,0 +1,208 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_LIVERECEIVER_H
+#define ROBOTV_LIVERECEIVER_H
+
+#include <stdint.h>
+#include <vdr/channels.h>
+#include <vdr/device.h>
+#include <vdr/receiver.h>
+
+#include "robotvdmx/demuxer.h"
+#include "robotvdmx/streambundle.h"
+#include "robotvdmx/demuxerbundle.h"
+#include "robotv/StreamPacketProcessor.h"
+#include "livequeue.h"
+
+#include <atomic>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+
+/**
+ * Shared live stream receiver.
+ * Receives, demuxes and queues a live channel once for all clients
+ * watching the same channel (with the same preferred language).
+ */
+class LiveReceiver : public cReceiver, protected StreamPacketProcessor {
+public:
+
+    /**
+     * Get a receiver for a channel.
+     * Returns an already running receiver of the channel or creates a new one.
+     * Every successful call must be paired with a call to release().
+     * @param channel the channel to receive
+     * @param priority receiver priority
+     * @param language preferred audio language
+     * @param streamType preferred audio stream type
+     * @param status resulting status code (ROBOTV_RET_...)
+     * @return pointer to the receiver or nullptr on failure
+     */
+    static LiveReceiver* acquire(const cChannel* channel, int priority, const std::string& language, StreamInfo::Type streamType, int& status);
+
+    /**
+     * Get a receiver for a channel on an idle device.
+     * Used to pre-tune channels the client will probably switch to. Devices
+     * in use won't be touched, the receiver will be detached if a recording
+     * or another client needs the device.
+     * Every successful call must be paired with a call to release().
+     * @param channel the channel to receive
+     * @param priority receiver priority
+     * @param language preferred audio language
+     * @param streamType preferred audio stream type
+     * @return pointer to the receiver or nullptr if there isn't any idle device
+     */
+    static LiveReceiver* preTune(const cChannel* channel, int priority, const std::string& language, StreamInfo::Type streamType);
+
+    /**
+     * Release a receiver.
+     * The receiver will be deleted if it isn't used by any other client.
+     * Otherwise the priority drops to the highest priority of the remaining clients.
+     * @param receiver pointer to the receiver
+     * @param priority priority used to acquire the receiver
+     */
+    static void release(LiveReceiver* receiver, int priority);
+
+    struct Status {
+        uint32_t channelUid;
+        int clients;
+        std::string language;
+        LiveQueue::Statistics queue;
+    };
+
+    /**
+     * Get the status of all running receivers.
+     * @return list of receiver states
+     */
+    static std::list<Status> getStatus();
+
+    /**
+     * Start streaming with the stream information of the channel cache.
+     * The clients don't have to wait until all streams have been parsed.
+     * @param on enable / disable fast start
+     */
+    static void setFastStart(bool on);
+
+    void processChannelChange(const cChannel* channel);
+
+    /**
+     * Select the streams of a client.
+     * Streams not selected by any client of the receiver won't be demuxed
+     * and stored. Streams added later (e.g. by a PMT change) are selected.
+     * @param client client identifier
+     * @param pids pids of the selected streams (empty for all streams)
+     * @return pids of the streams deselected by the client
+     */
+    std::set<int> selectStreams(uint32_t client, const std::set<int>& pids);
+
+    /**
+     * Remove the stream selection of a client.
+     * @param client client identifier
+     */
+    void removeStreamSelection(uint32_t client);
+
+    LiveQueue* getQueue() {
+        return m_queue;
+    }
+
+    uint32_t getChannelUid() {
+        return m_uid;
+    }
+
+    cDevice* getDevice() {
+        return Device();
+    }
+
+protected:
+
+#if VDRVERSNUM < 20300
+    void Receive(uchar* data, int length);
+#else
+    void Receive(const uchar* Data, int Length);
+#endif
+
+    int64_t getCurrentTime(TsDemuxer::StreamPacket *p);
+
+    void onPacket(MsgPacket* p, StreamInfo::Content content, int64_t pts);
+
+    MsgPacket* createStreamChangePacket(DemuxerBundle& bundle);
+
+private:
+
+    LiveReceiver(uint32_t uid, int priority, const std::string& language, StreamInfo::Type streamType);
+
+    virtual ~LiveReceiver();
+
+    int switchChannel(const cChannel* channel, cDevice* device = nullptr);
+
+    static cDevice* findIdleDevice(const cChannel* channel, int priority);
+
+    static cDevice* findTunedDevice(const cChannel* channel);
+
+    StreamBundle createFromChannel(const cChannel* channel);
+
+    void createDemuxers(StreamBundle* bundle);
+
+    void updateStreamSelection();
+
+    LiveQueue* m_queue = NULL;
+
+    std::string m_language;
+
+    StreamInfo::Type m_langStreamType = StreamInfo::Type::AC3;
+
+    uint32_t m_uid;
+
+    // stream information of the channel (used to detect real channel changes)
+    StreamBundle m_channelBundle;
+
+    // priorities of all clients using the receiver
+    std::multiset<int> m_holders;
+
+    std::mutex m_mutex;
+
+    // pids of the current streams
+    std::set<int> m_streamPids;
+
+    // pids deselected by the clients
+    std::map<uint32_t, std::set<int>> m_deselected;
+
+    std::mutex m_selectionMutex;
+
+    std::atomic<bool> m_selectionChanged;
+
+    static std::list<LiveReceiver*> m_receivers;
+
+    static std::mutex m_receiversMutex;
+
+    static int m_receiverId;
+
+    static bool m_fastStart;
+
+};
+
+#endif // ROBOTV_LIVERECEIVER_H
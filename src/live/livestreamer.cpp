@@ -23,6 +23,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <vdr/remux.h>
 #include <vdr/timers.h>
 
@@ -41,146 +42,82 @@
 
 #include "livestreamer.h"
 #include "livequeue.h"
-#include "channelcache.h"
 
 #include <chrono>
-#include <robotv/StreamPacketProcessor.h>
 
-#define MIN_PACKET_SIZE (128 * 1024)
+// target latency of a stream packet
+#define PACKET_LATENCY milliseconds(100)
+
+#define MAX_PACKET_SIZE (128 * 1024)
 
 using namespace std::chrono;
 
 LiveStreamer::LiveStreamer(RoboTvClient* parent, int priority)
-    : cReceiver(nullptr, priority)
-    , m_parent(parent)
-    , m_uid(0) {
-    // create send queue
-    m_queue = new LiveQueue(m_parent->getSocket());
+    : m_parent(parent)
+    , m_priority(priority)
+    , m_uid(0)
+    , m_aggregator(PACKET_LATENCY, MAX_PACKET_SIZE) {
 }
 
 LiveStreamer::~LiveStreamer() {
-    cDevice * device = Device();
-
-    if(device != nullptr) {
-        cCamSlot *camSlot = device->CamSlot();
-
-        if (camSlot != nullptr) {
-            isyslog("camslot detached");
-            ChannelCamRelations.ClrChecked(ChannelID(), camSlot->SlotNumber());
-        }
-
-        Detach();
-    }
-
-    reset();
-    delete m_queue;
+    close();
     delete m_streamPacket;
 
     isyslog("live streamer terminated");
 }
 
-int LiveStreamer::switchChannel(const cChannel* channel) {
-    if(channel == nullptr) {
-        esyslog("unknown channel !");
-        return ROBOTV_RET_ERROR;
-    }
-
-    // get device for this channel
-    cDevice* device = cDevice::GetDevice(channel, LIVEPRIORITY, false);
-
-    // maybe an encrypted channel that cannot be handled
-    // lets try if a device can decrypt it on it's own (without a CAM slot)
-    if(device == nullptr) {
-        device = cDevice::GetDeviceForTransponder(channel, LIVEPRIORITY);
-    }
+void LiveStreamer::close() {
+    delete m_reader;
+    m_reader = nullptr;
 
-    // maybe all devices busy
-    if(device == nullptr) {
-        esyslog("No device available !");
-        return ROBOTV_RET_DATALOCKED;
+    if(m_receiver != nullptr) {
+        m_receiver->removeStreamSelection(m_parent->getId());
+        LiveReceiver::release(m_receiver, m_priority);
+        m_receiver = nullptr;
     }
+}
 
-    isyslog("Found available device %d", device->DeviceNumber() + 1);
-
-    if(!device->SwitchChannel(channel, false)) {
-        esyslog("Can't switch to channel %i - %s", channel->Number(), channel->Name());
-        return ROBOTV_RET_ERROR;
-    }
-
-    m_uid = roboTV::Hash::createChannelUid(channel);
-
-    StreamBundle currentItem = createFromChannel(channel);
-
-    // get cached demuxer data
-    ChannelCache &cache = ChannelCache::instance();
-    StreamBundle cacheItem = cache.lookup(m_uid);
-
-    // channel already in cache
-    if (!cacheItem.empty()) {
-        isyslog("Channel information found in cache");
-    }
-    // channel not found in cache -> add it from vdr
-    else {
-        isyslog("adding channel to cache");
-        cacheItem = currentItem;
-        cache.add(m_uid, cacheItem);
-    }
+int LiveStreamer::switchChannel(const cChannel* channel) {
+    close();
 
-    // recheck cache item
-    if (!currentItem.isMetaOf(cacheItem)) {
-        isyslog("current channel differs from cache item - updating");
-        cacheItem = currentItem;
-        cache.add(m_uid, cacheItem);
-    }
+    int status = ROBOTV_RET_OK;
+    m_receiver = LiveReceiver::acquire(channel, m_priority, m_language, m_langStreamType, status);
 
-    if(cacheItem.empty()) {
-        esyslog("channel %i - %s doesn't have any stream information", channel->Number(), channel->Name());
-        return false;
+    if(m_receiver == nullptr) {
+        return status;
     }
 
-    isyslog("Creating demuxers");
-    createDemuxers(&cacheItem);
-
-    onStreamChange();
-
-    isyslog("Successfully switched to channel %i - %s", channel->Number(), channel->Name());
+    m_uid = m_receiver->getChannelUid();
+    m_deselected = m_receiver->selectStreams(m_parent->getId(), {});
+    m_reader = new LiveQueueReader(m_receiver->getQueue());
+    m_reader->setNotify([this]() {
+        notify();
+    });
 
-    // fool device to not start the decryption timer
-    int priority = Priority();
-    SetPriority(MINPRIORITY);
-
-    /// attach receiver
-    if (device->AttachReceiver(this) == false) {
-        esyslog("failed to attach receiver !");
-        return false;
-    }
-
-    // start decrypting manually
-    cCamSlot* slot = device->CamSlot();
+    return ROBOTV_RET_OK;
+}
 
-    if(slot) {
-        slot->StartDecrypting();
+void LiveStreamer::notify() {
+    {
+        std::lock_guard<std::mutex> lock(m_notifyMutex);
+        m_dataAvailable = true;
     }
 
-    SetPriority(priority);
+    m_notifyCondition.notify_one();
 
-    isyslog("done switching.");
-    return ROBOTV_RET_OK;
+    // wakeup client thread (push mode)
+    m_parent->wakeup();
 }
 
-MsgPacket *LiveStreamer::createStreamChangePacket(DemuxerBundle &bundle) {
-    StreamBundle cache;
+bool LiveStreamer::waitForData(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(m_notifyMutex);
 
-    for(auto i = bundle.begin(); i != bundle.end(); i++) {
-        cache.addStream(*(*i));
-    }
+    bool available = m_notifyCondition.wait_for(lock, timeout, [this]() {
+        return m_dataAvailable;
+    });
 
-    ChannelCache::instance().add(m_uid, cache);
-
-    // reorder streams as preferred
-    bundle.reorderStreams(m_language.c_str(), m_langStreamType);
-
-    return StreamPacketProcessor::createStreamChangePacket(bundle);
+    m_dataAvailable = false;
+    return available;
 }
 
 void LiveStreamer::sendStatus(int status) {
@@ -190,9 +127,13 @@ void LiveStreamer::sendStatus(int status) {
 }
 
 void LiveStreamer::requestSignalInfo() {
-    cDevice* device = Device();
+    if(m_receiver == nullptr) {
+        return;
+    }
+
+    cDevice* device = m_receiver->getDevice();
 
-    if(device == nullptr || !IsAttached()) {
+    if(device == nullptr || !m_receiver->IsAttached()) {
         return;
     }
 
@@ -260,7 +201,7 @@ void LiveStreamer::requestSignalInfo() {
     }
 
     dsyslog("RequestSignalInfo");
-    m_queue->queue(resp, StreamInfo::Content::NONE);
+    m_reader->queue(resp);
 }
 
 void LiveStreamer::setLanguage(const char* lang, StreamInfo::Type streamtype) {
@@ -273,36 +214,45 @@ void LiveStreamer::setLanguage(const char* lang, StreamInfo::Type streamtype) {
 }
 
 bool LiveStreamer::isPaused() {
-    if(m_queue == nullptr) {
+    if(m_reader == nullptr) {
         return false;
     }
 
-    return m_queue->isPaused();
+    return m_reader->isPaused();
 }
 
 void LiveStreamer::pause(bool on) {
-    if(m_queue == nullptr) {
+    if(m_reader == nullptr) {
         return;
     }
 
-    m_queue->pause(on);
+    m_reader->pause(on);
 }
 
-MsgPacket* LiveStreamer::requestPacket() {
+MsgPacket* LiveStreamer::requestPacket(bool keepAlive) {
     std::lock_guard<std::mutex> lock(m_mutex);
 
+    if(m_reader == nullptr) {
+        return nullptr;
+    }
+
     // create payload packet
     if(m_streamPacket == nullptr) {
         m_streamPacket = new MsgPacket();
-        m_streamPacket->put_S64(m_queue->getTimeshiftStartPosition());
+        m_streamPacket->put_S64(m_reader->getTimeshiftStartPosition());
         m_streamPacket->put_S64(roboTV::currentTimeMillis().count());
         m_streamPacket->disablePayloadCheckSum();
     }
 
     // request packet from queue
-    MsgPacket* p = nullptr;
+    std::shared_ptr<MsgPacket> p;
 
-    while((p = m_queue->read()) != nullptr) {
+    while((p = m_reader->read()) != nullptr) {
+
+        // skip streams not selected by the client
+        if(!m_deselected.empty() && m_deselected.find(getPid(p.get())) != m_deselected.end()) {
+            continue;
+        }
 
         // add data
         m_streamPacket->put_U16(p->getMsgID());
@@ -313,17 +263,20 @@ MsgPacket* LiveStreamer::requestPacket() {
         int length = p->getPayloadLength();
         m_streamPacket->put_Blob(data, length);
 
-        delete p;
-
         // send payload packet if it's big enough
-        if(m_streamPacket->getPayloadLength() >= MIN_PACKET_SIZE) {
+        if(m_aggregator.add(p.get(), m_streamPacket->getPayloadLength())) {
             MsgPacket* result = m_streamPacket;
             m_streamPacket = nullptr;
             return result;
         }
     }
 
-    if(m_queue->isPaused()) {
+    if(m_reader->isPaused()) {
+        // just the header (timeshift start position, wallclock time)
+        if(!keepAlive && m_streamPacket->getPayloadLength() <= 2 * sizeof(int64_t)) {
+            return nullptr;
+        }
+
         MsgPacket* result = m_streamPacket;
         m_streamPacket = nullptr;
         return result;
@@ -332,35 +285,34 @@ MsgPacket* LiveStreamer::requestPacket() {
     return nullptr;
 }
 
-void LiveStreamer::Receive(const uchar* packet, int length) {
-    putTsPacket((uint8_t*)packet, roboTV::currentTimeMillis().count());
-}
+void LiveStreamer::selectStreams(const std::set<int>& pids) {
+    std::lock_guard<std::mutex> lock(m_mutex);
 
-void LiveStreamer::processChannelChange(const cChannel* channel) {
-    if(roboTV::Hash::createChannelUid(channel) != m_uid) {
+    if(m_receiver == nullptr) {
         return;
     }
 
-    isyslog("ChannelChange()");
-
-    Detach();
-    cleanupQueue(); // remove pre-queued packets
-    switchChannel(channel);
+    m_deselected = m_receiver->selectStreams(m_parent->getId(), pids);
 }
 
-void LiveStreamer::createDemuxers(StreamBundle* bundle) {
-    DemuxerBundle& demuxers = getDemuxers();
+int LiveStreamer::getPid(MsgPacket* p) {
+    if(p->getMsgID() != ROBOTV_STREAM_MUXPKT || p->getPayloadLength() < sizeof(uint16_t)) {
+        return -1;
+    }
 
-    // update demuxers
-    demuxers.updateFrom(bundle);
+    // packets are shared, so don't touch the read position
+    uint16_t pid;
+    memcpy(&pid, p->getPayload(), sizeof(pid));
 
-    // update pids
-    SetPids(nullptr);
+    return be16toh(pid);
+}
 
-    for(auto i = demuxers.begin(); i != demuxers.end(); i++) {
-        TsDemuxer* dmx = *i;
-        AddPid(dmx->getPid());
+void LiveStreamer::processChannelChange(const cChannel* channel) {
+    if(m_receiver == nullptr) {
+        return;
     }
+
+    m_receiver->processChannelChange(channel);
 }
 
 int64_t LiveStreamer::seek(int64_t wallclockPositionMs) {
@@ -370,64 +322,12 @@ int64_t LiveStreamer::seek(int64_t wallclockPositionMs) {
     delete m_streamPacket;
     m_streamPacket = nullptr;
 
-    // seek
-    return m_queue->seek(wallclockPositionMs);
-}
-
-StreamBundle LiveStreamer::createFromChannel(const cChannel* channel) {
-    StreamBundle item;
-
-    // add video stream
-    int vpid = channel->Vpid();
-    int vtype = channel->Vtype();
-
-    item.addStream(StreamInfo(vpid,
-                              vtype == 0x02 ? StreamInfo::Type::MPEG2VIDEO :
-                              vtype == 0x1b ? StreamInfo::Type::H264 :
-                              vtype == 0x24 ? StreamInfo::Type::H265 :
-                              StreamInfo::Type::NONE));
-
-    // add (E)AC3 streams
-    for(int i = 0; channel->Dpid(i) != 0; i++) {
-        int dtype = channel->Dtype(i);
-        item.addStream(StreamInfo(channel->Dpid(i),
-                                  dtype == 0x6A ? StreamInfo::Type::AC3 :
-                                  dtype == 0x7A ? StreamInfo::Type::EAC3 :
-                                  StreamInfo::Type::NONE,
-                                  channel->Dlang(i)));
-    }
+    m_aggregator.reset();
 
-    // add audio streams
-    for(int i = 0; channel->Apid(i) != 0; i++) {
-        int atype = channel->Atype(i);
-        item.addStream(StreamInfo(channel->Apid(i),
-                                  atype == 0x04 ? StreamInfo::Type::MPEG2AUDIO :
-                                  atype == 0x03 ? StreamInfo::Type::MPEG2AUDIO :
-                                  atype == 0x0f ? StreamInfo::Type::AAC :
-                                  atype == 0x11 ? StreamInfo::Type::LATM :
-                                  StreamInfo::Type::NONE,
-                                  channel->Alang(i)));
+    if(m_reader == nullptr) {
+        return 0;
     }
 
-    // add subtitle streams
-    for(int i = 0; channel->Spid(i) != 0; i++) {
-        StreamInfo stream(channel->Spid(i), StreamInfo::Type::DVBSUB, channel->Slang(i));
-
-        stream.setSubtitlingDescriptor(
-                channel->SubtitlingType(i),
-                channel->CompositionPageId(i),
-                channel->AncillaryPageId(i));
-
-        item.addStream(stream);
-    }
-
-    return item;
-}
-
-int64_t LiveStreamer::getCurrentTime(TsDemuxer::StreamPacket *p) {
-    return p->streamPosition;
-}
-
-void LiveStreamer::onPacket(MsgPacket *p, StreamInfo::Content content, int64_t pts) {
-    m_queue->queue(p, content, pts);
+    // seek
+    return m_reader->seek(wallclockPositionMs);
 }
@@ -22,36 +22,46 @@
  *
  */
 
-#ifndef ROBOTV_RECEIVER_H
-#define ROBOTV_RECEIVER_H
+#ifndef ROBOTV_LIVESTREAMER_H
+#define ROBOTV_LIVESTREAMER_H
 
 #include <stdint.h>
 #include <vdr/channels.h>
-#include <vdr/device.h>
-#include <vdr/receiver.h>
-#include <vdr/ringbuffer.h>
 
-#include "robotvdmx/demuxer.h"
-#include "robotvdmx/streambundle.h"
-#include "robotvdmx/demuxerbundle.h"
+#include "robotvdmx/streaminfo.h"
 #include "robotv/robotvcommand.h"
+#include "tools/packetaggregator.h"
 #include "livequeue.h"
+#include "livereceiver.h"
 
-#include <list>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
-#include <robotv/StreamPacketProcessor.h>
+#include <set>
+#include <string>
 
 class cChannel;
 class MsgPacket;
-class LiveQueue;
 class RoboTvClient;
 
-class LiveStreamer : public cReceiver, protected StreamPacketProcessor {
+/**
+ * Live stream of a client.
+ * Reads the packets of a (shared) live receiver.
+ */
+class LiveStreamer {
 private:
 
     void sendStatus(int status);
 
-    LiveQueue* m_queue = NULL;
+    void close();
+
+    void notify();
+
+    static int getPid(MsgPacket* p);
+
+    LiveReceiver* m_receiver = NULL;
+
+    LiveQueueReader* m_reader = NULL;
 
     RoboTvClient* m_parent = NULL;
 
@@ -59,31 +69,24 @@ private:
 
     StreamInfo::Type m_langStreamType = StreamInfo::Type::AC3;
 
+    int m_priority;
+
     uint32_t m_uid;
 
     std::mutex m_mutex;
 
     MsgPacket* m_streamPacket = NULL;
 
-protected:
+    roboTV::PacketAggregator m_aggregator;
 
-#if VDRVERSNUM < 20300
-    void Receive(uchar* data, int length);
-#else
-    void Receive(const uchar* Data, int Length);
-#endif
+    // streams not selected by the client
+    std::set<int> m_deselected;
 
-    int64_t getCurrentTime(TsDemuxer::StreamPacket *p);
+    std::mutex m_notifyMutex;
 
-    void onPacket(MsgPacket* p, StreamInfo::Content content, int64_t pts);
+    std::condition_variable m_notifyCondition;
 
-    MsgPacket* createStreamChangePacket(DemuxerBundle& bundle);
-
-private:
-
-    StreamBundle createFromChannel(const cChannel* channel);
-
-    void createDemuxers(StreamBundle* bundle);
+    bool m_dataAvailable = false;
 
 public:
 
@@ -99,7 +102,19 @@ public:
 
     void pause(bool on);
 
-    MsgPacket* requestPacket();
+    /**
+     * Get the next stream packet.
+     * @param keepAlive return packets without any stream data while the stream is paused
+     * @return stream packet or nullptr if there isn't enough data yet
+     */
+    MsgPacket* requestPacket(bool keepAlive = true);
+
+    /**
+     * Wait for new data in the live queue.
+     * @param timeout maximum time to wait
+     * @return true if new data arrived
+     */
+    bool waitForData(std::chrono::milliseconds timeout);
 
     void requestSignalInfo();
 
@@ -107,6 +122,12 @@ public:
 
     int64_t seek(int64_t wallclockPositionMs);
 
+    /**
+     * Select the streams sent to the client.
+     * @param pids pids of the selected streams (empty for all streams)
+     */
+    void selectStreams(const std::set<int>& pids);
+
 };
 
-#endif  // ROBOTV_RECEIVER_H
+#endif  // ROBOTV_LIVESTREAMER_H
@@ -0,0 +1,83 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "pretuner.h"
+#include "livereceiver.h"
+
+int PreTuner::m_channels = 0;
+int PreTuner::m_priority = -50;
+
+PreTuner::~PreTuner() {
+    clear();
+}
+
+void PreTuner::setChannels(int count) {
+    m_channels = count;
+}
+
+void PreTuner::setPriority(int priority) {
+    // pre-tuned channels must never block live streams
+    if(priority >= LIVEPRIORITY) {
+        priority = LIVEPRIORITY - 1;
+    }
+
+    m_priority = priority;
+}
+
+void PreTuner::update(const cChannels* channels, const cChannel* channel, const std::string& language, StreamInfo::Type streamType) {
+    if(m_channels <= 0 || channel == nullptr) {
+        return;
+    }
+
+    std::list<std::pair<LiveReceiver*, int>> receivers;
+
+    for(int i = 1; i <= m_channels; i++) {
+        for(int number : { channel->Number() + i, channel->Number() - i }) {
+            const cChannel* adjacent = channels->GetByNumber(number);
+
+            if(adjacent == nullptr) {
+                continue;
+            }
+
+            LiveReceiver* receiver = LiveReceiver::preTune(adjacent, m_priority, language, streamType);
+
+            if(receiver != nullptr) {
+                receivers.push_back({ receiver, m_priority });
+            }
+        }
+    }
+
+    // release the old channels after acquiring the new ones
+    // (receivers still in use will be kept)
+    clear();
+    m_receivers = receivers;
+}
+
+void PreTuner::clear() {
+    for(auto& i: m_receivers) {
+        LiveReceiver::release(i.first, i.second);
+    }
+
+    m_receivers.clear();
+}
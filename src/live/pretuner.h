@@ -0,0 +1,82 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_PRETUNER_H
+#define ROBOTV_PRETUNER_H
+
+#include <list>
+#include <string>
+#include <utility>
+
+#include <vdr/channels.h>
+
+#include "robotvdmx/streaminfo.h"
+
+class LiveReceiver;
+
+/**
+ * Pre-tuning of adjacent channels.
+ * Keeps receivers for the channels next to the current channel of a client
+ * running on idle devices. The live queue of these receivers holds the last
+ * GOP, so switching to an adjacent channel starts immediately.
+ */
+class PreTuner {
+public:
+
+    PreTuner() = default;
+
+    virtual ~PreTuner();
+
+    /**
+     * Update the pre-tuned channels.
+     * @param channels the (locked) channel list
+     * @param channel current channel of the client
+     * @param language preferred audio language
+     * @param streamType preferred audio stream type
+     */
+    void update(const cChannels* channels, const cChannel* channel, const std::string& language, StreamInfo::Type streamType);
+
+    /**
+     * Release all pre-tuned channels.
+     */
+    void clear();
+
+    static void setChannels(int count);
+
+    static void setPriority(int priority);
+
+private:
+
+    PreTuner(const PreTuner& orig);
+
+    // pre-tuned receivers and the priority they were acquired with
+    std::list<std::pair<LiveReceiver*, int>> m_receivers;
+
+    // number of channels to pre-tune in each direction (0 = disabled)
+    static int m_channels;
+
+    static int m_priority;
+};
+
+#endif // ROBOTV_PRETUNER_H
@@ -0,0 +1,205 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <vdr/remux.h>
+
+#include "net/msgpacket.h"
+#include "robotv/robotvclient.h"
+#include "robotv/robotvcommand.h"
+#include "tools/hash.h"
+#include "tools/time.h"
+
+#include "previewreceiver.h"
+
+PreviewReceiver::PreviewReceiver(RoboTvClient* parent, std::chrono::milliseconds interval, int priority)
+    : cReceiver(nullptr, priority)
+    , m_parent(parent)
+    , m_demuxers(this)
+    , m_interval(interval) {
+}
+
+PreviewReceiver::~PreviewReceiver() {
+    Detach();
+    isyslog("preview receiver terminated");
+}
+
+PreviewReceiver* PreviewReceiver::create(RoboTvClient* parent, const std::list<const cChannel*>& channels, std::chrono::milliseconds interval, int priority, int& status) {
+    if(channels.empty()) {
+        status = ROBOTV_RET_DATAINVALID;
+        return nullptr;
+    }
+
+    const cChannel* first = channels.front();
+    PreviewReceiver* receiver = new PreviewReceiver(parent, interval, priority);
+
+    // all channels must be on the same transponder
+    for(auto channel: channels) {
+        if(channel->Source() != first->Source() || !ISTRANSPONDER(channel->Transponder(), first->Transponder())) {
+            isyslog("preview: channel %i - %s not on transponder of %s - skipping", channel->Number(), channel->Name(), first->Name());
+            continue;
+        }
+
+        if(channel->Ca() >= CA_ENCRYPTED_MIN || channel->Vpid() == 0) {
+            isyslog("preview: channel %i - %s encrypted or without video - skipping", channel->Number(), channel->Name());
+            continue;
+        }
+
+        receiver->addChannel(channel);
+    }
+
+    if(receiver->m_channels.empty()) {
+        delete receiver;
+        status = ROBOTV_RET_DATAINVALID;
+        return nullptr;
+    }
+
+    cDevice* device = cDevice::GetDevice(first, priority, false);
+
+    if(device == nullptr) {
+        esyslog("preview: no device available !");
+        delete receiver;
+        status = ROBOTV_RET_DATALOCKED;
+        return nullptr;
+    }
+
+    if(!device->IsTunedToTransponder(first) && !device->SwitchChannel(first, false)) {
+        esyslog("preview: can't switch to transponder of channel %i - %s", first->Number(), first->Name());
+        delete receiver;
+        status = ROBOTV_RET_ERROR;
+        return nullptr;
+    }
+
+    if(!device->AttachReceiver(receiver)) {
+        esyslog("preview: failed to attach receiver !");
+        delete receiver;
+        status = ROBOTV_RET_ERROR;
+        return nullptr;
+    }
+
+    isyslog("preview of %lu channels on device %d", receiver->m_channels.size(), device->DeviceNumber() + 1);
+
+    status = ROBOTV_RET_OK;
+    return receiver;
+}
+
+void PreviewReceiver::addChannel(const cChannel* channel) {
+    int vpid = channel->Vpid();
+    int vtype = channel->Vtype();
+
+    StreamBundle bundle;
+
+    for(auto dmx: m_demuxers) {
+        bundle.addStream(*dmx);
+    }
+
+    bundle.addStream(StreamInfo(vpid,
+                                vtype == 0x02 ? StreamInfo::Type::MPEG2VIDEO :
+                                vtype == 0x1b ? StreamInfo::Type::H264 :
+                                vtype == 0x24 ? StreamInfo::Type::H265 :
+                                StreamInfo::Type::NONE));
+
+    m_demuxers.updateFrom(&bundle);
+    m_channels[vpid] = roboTV::Hash::createChannelUid(channel);
+
+    AddPid(vpid);
+}
+
+std::list<uint32_t> PreviewReceiver::getChannels() const {
+    std::list<uint32_t> list;
+
+    for(auto i: m_channels) {
+        list.push_back(i.second);
+    }
+
+    return list;
+}
+
+void PreviewReceiver::Receive(const uchar* packet, int length) {
+    m_demuxers.processTsPackets((uint8_t*)packet, length / TS_SIZE, 0);
+}
+
+void PreviewReceiver::onStreamPacket(TsDemuxer::StreamPacket* p) {
+    if(p == nullptr || p->data == nullptr || p->size == 0 || p->frameType != StreamInfo::FrameType::IFRAME) {
+        return;
+    }
+
+    // limit keyframe rate per channel
+    std::chrono::milliseconds now = roboTV::currentTimeMillis();
+    auto last = m_lastKeyFrame.find((int)p->pid);
+
+    if(last != m_lastKeyFrame.end() && now - last->second < m_interval) {
+        return;
+    }
+
+    // wait for the stream information
+    TsDemuxer* dmx = m_demuxers.findDemuxer((int)p->pid);
+
+    if(dmx == nullptr || !dmx->isParsed()) {
+        return;
+    }
+
+    m_lastKeyFrame[(int)p->pid] = now;
+
+    MsgPacket* packet = new MsgPacket(ROBOTV_STREAM_PREVIEW, ROBOTV_CHANNEL_STREAM);
+    packet->disablePayloadCheckSum();
+
+    packet->put_U32(m_channels[(int)p->pid]);
+    packet->put_String(dmx->typeName());
+    packet->put_U32(dmx->getHeight());
+    packet->put_U32(dmx->getWidth());
+
+    // decoder data
+    int length = 0;
+    uint8_t* data = dmx->getVideoDecoderSps(length);
+    packet->put_U8((uint8_t)length);
+
+    if(data != nullptr) {
+        packet->put_Blob(data, (uint8_t)length);
+    }
+
+    data = dmx->getVideoDecoderPps(length);
+    packet->put_U8((uint8_t)length);
+
+    if(data != nullptr) {
+        packet->put_Blob(data, (uint8_t)length);
+    }
+
+    data = dmx->getVideoDecoderVps(length);
+    packet->put_U8((uint8_t)length);
+
+    if(data != nullptr) {
+        packet->put_Blob(data, (uint8_t)length);
+    }
+
+    // keyframe
+    packet->put_S64(p->pts);
+    packet->put_U32((uint32_t)p->size);
+    packet->put_Blob(p->data, (uint32_t)p->size);
+
+    m_parent->queueMessage(packet);
+}
+
+void PreviewReceiver::onStreamChange() {
+    // stream information is sent with every keyframe
+}
@@ -0,0 +1,105 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_PREVIEWRECEIVER_H
+#define ROBOTV_PREVIEWRECEIVER_H
+
+#include <stdint.h>
+#include <vdr/channels.h>
+#include <vdr/device.h>
+#include <vdr/receiver.h>
+
+#include "robotvdmx/demuxer.h"
+#include "robotvdmx/demuxerbundle.h"
+
+#include <chrono>
+#include <list>
+#include <map>
+
+class RoboTvClient;
+
+/**
+ * Keyframe preview of several channels.
+ * Receives the video streams of channels on the same transponder with a
+ * single device and sends their keyframes (at a limited rate) to the
+ * client. Used for mosaic previews in the channel guide.
+ */
+class PreviewReceiver : public cReceiver, protected TsDemuxer::Listener {
+public:
+
+    /**
+     * Create a preview receiver.
+     * Channels on other transponders than the first one and encrypted
+     * channels will be skipped.
+     * @param parent client receiving the keyframes
+     * @param channels channels to preview
+     * @param interval minimum time between two keyframes of a channel
+     * @param priority receiver priority
+     * @param status resulting status code (ROBOTV_RET_...)
+     * @return pointer to the receiver or nullptr on failure
+     */
+    static PreviewReceiver* create(RoboTvClient* parent, const std::list<const cChannel*>& channels, std::chrono::milliseconds interval, int priority, int& status);
+
+    virtual ~PreviewReceiver();
+
+    /**
+     * Get the previewed channels.
+     * @return list of channel uids
+     */
+    std::list<uint32_t> getChannels() const;
+
+protected:
+
+#if VDRVERSNUM < 20300
+    void Receive(uchar* data, int length);
+#else
+    void Receive(const uchar* Data, int Length);
+#endif
+
+    void onStreamPacket(TsDemuxer::StreamPacket* p) override;
+
+    void onStreamChange() override;
+
+private:
+
+    PreviewReceiver(RoboTvClient* parent, std::chrono::milliseconds interval, int priority);
+
+    PreviewReceiver(const PreviewReceiver& orig);
+
+    void addChannel(const cChannel* channel);
+
+    RoboTvClient* m_parent;
+
+    DemuxerBundle m_demuxers;
+
+    // video pid -> channel uid
+    std::map<int, uint32_t> m_channels;
+
+    // video pid -> time of the last keyframe sent
+    std::map<int, std::chrono::milliseconds> m_lastKeyFrame;
+
+    std::chrono::milliseconds m_interval;
+};
+
+#endif // ROBOTV_PREVIEWRECEIVER_H
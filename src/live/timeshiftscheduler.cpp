@@ -0,0 +1,473 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <sys/statvfs.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <set>
+
+#include <vdr/tools.h>
+
+#include "tools/time.h"
+#include "timeshiftscheduler.h"
+
+// sync interval of a segment (in ms)
+// syncs of all running timeshift buffers are staggered within this interval
+#define SYNC_INTERVAL 2000
+
+// suffix of segments in progress of compaction
+#define TMP_SUFFIX ".tmp"
+
+TimeShiftScheduler::TimeShiftScheduler() :
+    m_running(true),
+    m_nextDirectory(0),
+    m_maxBufferSize(1024 * 1024 * 1024),
+    m_minFreeSpace(10),
+    m_buffers(0),
+    m_usedSpace(0),
+    m_bandwidth(0),
+    m_tokens(0) {
+    m_directories.push_back("/video");
+    m_nextSyncTime = roboTV::currentTimeMillis();
+    m_lastRefill = roboTV::currentTimeMillis();
+
+    m_thread = std::thread([&]() {
+        process();
+    });
+}
+
+TimeShiftScheduler::~TimeShiftScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_running = false;
+        m_condition.notify_one();
+    }
+
+    m_thread.join();
+}
+
+TimeShiftScheduler& TimeShiftScheduler::instance() {
+    static TimeShiftScheduler scheduler;
+    return scheduler;
+}
+
+void TimeShiftScheduler::setDirectories(const std::string& dirs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string::size_type start = 0;
+
+    m_directories.clear();
+
+    while(start <= dirs.size()) {
+        std::string::size_type end = dirs.find(':', start);
+
+        if(end == std::string::npos) {
+            end = dirs.size();
+        }
+
+        std::string dir = dirs.substr(start, end - start);
+
+        if(!dir.empty()) {
+            dsyslog("TIMESHIFTDIR: %s", dir.c_str());
+            m_directories.push_back(dir);
+        }
+
+        start = end + 1;
+    }
+
+    if(m_directories.empty()) {
+        m_directories.push_back("/video");
+    }
+
+    m_nextDirectory = 0;
+}
+
+void TimeShiftScheduler::setMaxBufferSize(uint64_t size) {
+    m_maxBufferSize = size;
+    isyslog("timeshift buffersize: %lu bytes", m_maxBufferSize);
+}
+
+void TimeShiftScheduler::setBandwidth(uint64_t bytesPerSecond) {
+    std::lock_guard<std::mutex> lock(m_bandwidthMutex);
+
+    m_bandwidth = bytesPerSecond;
+    m_tokens = (double)bytesPerSecond;
+
+    isyslog("timeshift bandwidth: %lu bytes/s", m_bandwidth);
+}
+
+void TimeShiftScheduler::setMinFreeSpace(int percent) {
+    m_minFreeSpace = std::min(std::max(percent, 0), 100);
+    isyslog("timeshift minimum free space: %i%%", m_minFreeSpace);
+}
+
+uint64_t TimeShiftScheduler::getMaxBufferSize() {
+    return m_maxBufferSize;
+}
+
+uint64_t TimeShiftScheduler::getAvailableSpace(const std::string& dir) {
+    struct statvfs st;
+
+    if(statvfs(dir.c_str(), &st) != 0) {
+        return 0;
+    }
+
+    uint64_t available = (uint64_t)st.f_bavail * st.f_frsize;
+    uint64_t reserved = (uint64_t)st.f_blocks * st.f_frsize / 100 * m_minFreeSpace;
+
+    return (available > reserved) ? available - reserved : 0;
+}
+
+uint64_t TimeShiftScheduler::getBufferSize() {
+    std::vector<std::string> directories;
+    int buffers = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        directories = m_directories;
+        buffers = std::max(m_buffers, 1);
+    }
+
+    // space already used by the timeshift buffers is available too
+    uint64_t space = m_usedSpace;
+
+    for(auto& dir: directories) {
+        space += getAvailableSpace(dir);
+    }
+
+    return std::min(space / buffers, m_maxBufferSize);
+}
+
+void TimeShiftScheduler::addBuffer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers++;
+}
+
+void TimeShiftScheduler::removeBuffer() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers--;
+}
+
+bool TimeShiftScheduler::consumeBandwidth(off_t bytes, bool optional) {
+    std::lock_guard<std::mutex> lock(m_bandwidthMutex);
+
+    if(m_bandwidth == 0) {
+        return true;
+    }
+
+    // refill budget (burst of max. 1 second)
+    std::chrono::milliseconds now = roboTV::currentTimeMillis();
+    double budget = (double)m_bandwidth;
+
+    m_tokens = std::min(m_tokens + budget * (now - m_lastRefill).count() / 1000.0, budget);
+    m_lastRefill = now;
+
+    if(optional && m_tokens < bytes) {
+        return false;
+    }
+
+    // mandatory data may exceed the budget
+    m_tokens = std::max(m_tokens - bytes, -budget);
+    return true;
+}
+
+std::shared_ptr<TimeShiftSegment> TimeShiftScheduler::createSegment(const std::string& name, uint64_t start, off_t capacity, const std::string& directory) {
+    std::vector<std::string> directories;
+    size_t next = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        directories = m_directories;
+        next = m_nextDirectory++;
+    }
+
+    // stripe segments over all directories (skip full ones)
+    std::string dir = directories[next % directories.size()];
+
+    for(size_t i = 0; i < directories.size() && directory.empty(); i++) {
+        std::string d = directories[(next + i) % directories.size()];
+
+        if(getAvailableSpace(d) >= (uint64_t)capacity) {
+            dir = d;
+            break;
+        }
+    }
+
+    if(!directory.empty()) {
+        dir = directory;
+    }
+
+    std::string baseName = dir + "/" + name;
+    dsyslog("timeshift segment: %s", baseName.c_str());
+
+    std::shared_ptr<TimeShiftSegment> segment(new TimeShiftSegment(baseName, start), [this, capacity](TimeShiftSegment* s) {
+        delete s;
+        m_usedSpace -= capacity;
+    });
+
+    m_usedSpace += capacity;
+
+    if(!segment->create(capacity)) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_active.push_back(segment);
+
+    return segment;
+}
+
+std::shared_ptr<TimeShiftSegment> TimeShiftScheduler::createReplacement(const TimeShiftSegment& segment) {
+    return createSegment(segment.getName() + TMP_SUFFIX, segment.getStart(), segment.getLength(), segment.getDirectory());
+}
+
+std::shared_ptr<TimeShiftSegment> TimeShiftScheduler::openSegment(const std::string& baseName, uint64_t start) {
+    TimeShiftSegment* s = new TimeShiftSegment(baseName, start);
+
+    if(!s->open()) {
+        delete s;
+        return nullptr;
+    }
+
+    off_t length = s->getLength();
+    m_usedSpace += length;
+
+    return std::shared_ptr<TimeShiftSegment>(s, [this, length](TimeShiftSegment* s) {
+        delete s;
+        m_usedSpace -= length;
+    });
+}
+
+std::vector<std::string> TimeShiftScheduler::findSegments(const std::string& prefix) {
+    std::vector<std::string> directories;
+    std::vector<std::pair<std::string, std::string>> files;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        directories = m_directories;
+    }
+
+    std::set<std::string> leftovers;
+
+    for(auto& dirName: directories) {
+        DIR* dir = opendir(dirName.c_str());
+
+        if(dir == nullptr) {
+            continue;
+        }
+
+        struct dirent* entry = nullptr;
+
+        while((entry = readdir(dir)) != nullptr) {
+            std::string name = entry->d_name;
+
+            if(name.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+
+            // temporary files of a compaction
+            size_t tmp = name.find(TMP_SUFFIX ".");
+
+            if(tmp != std::string::npos) {
+                leftovers.insert(dirName + "/" + name.substr(0, tmp));
+                continue;
+            }
+
+            if(name.size() < 5 || name.compare(name.size() - 5, 5, ".data") != 0) {
+                continue;
+            }
+
+            files.push_back({name.substr(0, name.size() - 5), dirName});
+        }
+
+        closedir(dir);
+    }
+
+    for(auto& baseName: leftovers) {
+        std::string tmpName = baseName + TMP_SUFFIX;
+
+        // compaction didn't finish -> keep the original segment
+        if(access((tmpName + ".data").c_str(), F_OK) == 0) {
+            isyslog("Removing incomplete timeshift segment: %s", tmpName.c_str());
+            unlink((tmpName + ".data").c_str());
+            unlink((tmpName + ".idx").c_str());
+            continue;
+        }
+
+        // compacted data already in place -> move the index too
+        if(rename((tmpName + ".idx").c_str(), (baseName + ".idx").c_str()) == -1) {
+            unlink((baseName + ".idx").c_str());
+        }
+    }
+
+    // segment numbers are zero-padded
+    std::sort(files.begin(), files.end());
+
+    std::vector<std::string> list;
+
+    for(auto& f: files) {
+        list.push_back(f.second + "/" + f.first);
+    }
+
+    return list;
+}
+
+void TimeShiftScheduler::removeFiles(const std::string& prefix) {
+    std::vector<std::string> directories;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        directories = m_directories;
+    }
+
+    for(auto& dirName: directories) {
+        DIR* dir = opendir(dirName.c_str());
+
+        if(dir == nullptr) {
+            continue;
+        }
+
+        struct dirent* entry = nullptr;
+
+        while((entry = readdir(dir)) != nullptr) {
+            if(strncmp(entry->d_name, prefix.c_str(), prefix.size()) == 0) {
+                isyslog("Removing old time-shift storage: %s", entry->d_name);
+                unlink(AddDirectory(dirName.c_str(), entry->d_name));
+            }
+        }
+
+        closedir(dir);
+    }
+}
+
+void TimeShiftScheduler::writeback(const std::shared_ptr<TimeShiftSegment>& segment, off_t from, off_t to) {
+    submit({segment, from, to, false});
+}
+
+void TimeShiftScheduler::sync(const std::shared_ptr<TimeShiftSegment>& segment) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // segment completed - no more periodic syncs
+    m_active.remove_if([&](const std::weak_ptr<TimeShiftSegment>& s) {
+        return s.expired() || s.lock() == segment;
+    });
+
+    for(auto& r: m_requests) {
+        if(r.segment == segment && r.sync) {
+            return;
+        }
+    }
+
+    m_requests.push_back({segment, 0, 0, true});
+    m_condition.notify_one();
+}
+
+void TimeShiftScheduler::submit(const Request& request) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // merge with pending requests of the segment
+    for(auto& r: m_requests) {
+        if(r.segment != request.segment) {
+            continue;
+        }
+
+        // already syncing the whole segment
+        if(r.sync) {
+            return;
+        }
+
+        // extend writeback range
+        if(r.to == request.from) {
+            r.to = request.to;
+            return;
+        }
+    }
+
+    m_requests.push_back(request);
+    m_condition.notify_one();
+}
+
+std::shared_ptr<TimeShiftSegment> TimeShiftScheduler::nextSync() {
+    // m_mutex must be locked by the caller
+    while(!m_active.empty()) {
+        auto segment = m_active.front().lock();
+        m_active.pop_front();
+
+        if(segment) {
+            m_active.push_back(segment);
+            return segment;
+        }
+    }
+
+    return nullptr;
+}
+
+void TimeShiftScheduler::process() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while(m_running) {
+        std::chrono::milliseconds timeout = m_nextSyncTime - roboTV::currentTimeMillis();
+
+        m_condition.wait_for(lock, std::max(timeout, std::chrono::milliseconds(1)), [&]() {
+            return !m_running || !m_requests.empty();
+        });
+
+        while(!m_requests.empty()) {
+            Request r = m_requests.front();
+            m_requests.pop_front();
+
+            // don't block writers while we are waiting for the disk
+            lock.unlock();
+
+            if(r.sync) {
+                r.segment->sync();
+            }
+            else {
+                r.segment->writeback(r.from, r.to);
+            }
+
+            r.segment.reset();
+            lock.lock();
+        }
+
+        // staggered sync of the segments currently written
+        std::chrono::milliseconds now = roboTV::currentTimeMillis();
+
+        if(now < m_nextSyncTime) {
+            continue;
+        }
+
+        auto segment = nextSync();
+        m_nextSyncTime = now + std::chrono::milliseconds(SYNC_INTERVAL / std::max<size_t>(m_active.size(), 1));
+
+        if(segment) {
+            lock.unlock();
+            segment->sync();
+            segment.reset();
+            lock.lock();
+        }
+    }
+}
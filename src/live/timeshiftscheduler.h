@@ -0,0 +1,223 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_TIMESHIFTSCHEDULER_H
+#define ROBOTV_TIMESHIFTSCHEDULER_H
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "timeshiftsegment.h"
+
+/**
+ * Process-wide timeshift I/O scheduler.
+ * Owns the timeshift storage of all live queues. Creates the segments (striped
+ * over all configured directories), shares the available disk space and write
+ * bandwidth between the running timeshift buffers, and performs writeback and
+ * staggered syncs in the background, so the timeshift writers never block on
+ * a slow disk.
+ */
+class TimeShiftScheduler {
+public:
+
+    virtual ~TimeShiftScheduler();
+
+    /**
+     * Set the timeshift directories.
+     * @param dirs list of directories (separated by ':')
+     */
+    void setDirectories(const std::string& dirs);
+
+    /**
+     * Set the maximum size of a timeshift buffer.
+     * @param size maximum size in bytes
+     */
+    void setMaxBufferSize(uint64_t size);
+
+    /**
+     * Set the total write bandwidth of all timeshift buffers.
+     * @param bytesPerSecond bandwidth limit (0 = unlimited)
+     */
+    void setBandwidth(uint64_t bytesPerSecond);
+
+    /**
+     * Set the disk space reserved for other applications.
+     * @param percent minimum free space of a timeshift directory (in percent)
+     */
+    void setMinFreeSpace(int percent);
+
+    uint64_t getMaxBufferSize();
+
+    /**
+     * Get the size of a timeshift buffer.
+     * The available space of all directories is shared between all running buffers.
+     * @return the size in bytes (limited by the maximum buffer size)
+     */
+    uint64_t getBufferSize();
+
+    /**
+     * Register a running timeshift buffer.
+     */
+    void addBuffer();
+
+    /**
+     * Unregister a timeshift buffer.
+     */
+    void removeBuffer();
+
+    /**
+     * Check the bandwidth budget.
+     * @param bytes number of bytes to write
+     * @param optional data can be skipped if the budget is exhausted
+     * @return false if optional data should be skipped
+     */
+    bool consumeBandwidth(off_t bytes, bool optional);
+
+    /**
+     * Create a new segment.
+     * @param name filename of the segment (without directory and extension)
+     * @param start stream position of the segment
+     * @param capacity size of the segment in bytes
+     * @param directory directory of the segment (empty = next timeshift directory)
+     * @return the segment or nullptr on failure
+     */
+    std::shared_ptr<TimeShiftSegment> createSegment(const std::string& name, uint64_t start, off_t capacity, const std::string& directory = std::string());
+
+    /**
+     * Open an existing segment.
+     * @param baseName full filename of the segment (without extension)
+     * @param start stream position of the segment
+     * @return the segment or nullptr on failure
+     */
+    std::shared_ptr<TimeShiftSegment> openSegment(const std::string& baseName, uint64_t start);
+
+    /**
+     * Create a temporary segment replacing an existing segment.
+     * The segment is created in the directory of the existing segment, so it
+     * can be moved over it with TimeShiftSegment::replace().
+     * @param segment segment to replace
+     * @return the segment or nullptr on failure
+     */
+    std::shared_ptr<TimeShiftSegment> createReplacement(const TimeShiftSegment& segment);
+
+    /**
+     * Find segments in all timeshift directories.
+     * Leftovers of an interrupted compaction are removed (or completed).
+     * @param prefix filename prefix
+     * @return full filenames (without extension) ordered by filename
+     */
+    std::vector<std::string> findSegments(const std::string& prefix);
+
+    /**
+     * Remove files from all timeshift directories.
+     * @param prefix filename prefix
+     */
+    void removeFiles(const std::string& prefix);
+
+    /**
+     * Start writeback of a range of a segment.
+     * @param segment the segment
+     * @param from start offset within the segment
+     * @param to end offset within the segment
+     */
+    void writeback(const std::shared_ptr<TimeShiftSegment>& segment, off_t from, off_t to);
+
+    /**
+     * Sync a completed segment to disk.
+     * @param segment the segment
+     */
+    void sync(const std::shared_ptr<TimeShiftSegment>& segment);
+
+    static TimeShiftScheduler& instance();
+
+protected:
+
+    TimeShiftScheduler();
+
+private:
+
+    struct Request {
+        std::shared_ptr<TimeShiftSegment> segment;
+        off_t from;
+        off_t to;
+        bool sync;
+    };
+
+    void submit(const Request& request);
+
+    void process();
+
+    std::shared_ptr<TimeShiftSegment> nextSync();
+
+    uint64_t getAvailableSpace(const std::string& dir);
+
+    std::thread m_thread;
+
+    std::mutex m_mutex;
+
+    std::condition_variable m_condition;
+
+    std::deque<Request> m_requests;
+
+    // segments currently written (synced periodically)
+    std::list<std::weak_ptr<TimeShiftSegment>> m_active;
+
+    std::chrono::milliseconds m_nextSyncTime;
+
+    bool m_running;
+
+    std::vector<std::string> m_directories;
+
+    size_t m_nextDirectory;
+
+    uint64_t m_maxBufferSize;
+
+    int m_minFreeSpace;
+
+    int m_buffers;
+
+    // space allocated by all segments
+    std::atomic<uint64_t> m_usedSpace;
+
+    std::mutex m_bandwidthMutex;
+
+    uint64_t m_bandwidth;
+
+    double m_tokens;
+
+    std::chrono::milliseconds m_lastRefill;
+
+};
+
+#endif // ROBOTV_TIMESHIFTSCHEDULER_H
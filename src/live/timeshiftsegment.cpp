@@ -0,0 +1,422 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __FreeBSD__
+#include <sys/endian.h>
+#else
+#include <endian.h>
+#endif
+
+#include <vdr/tools.h>
+
+#include "net/msgpacket.h"
+#include "tools/time.h"
+#include "timeshiftsegment.h"
+
+const off_t TimeShiftSegment::BlockSize;
+
+TimeShiftSegment::TimeShiftSegment(const std::string& baseName, uint64_t start) :
+    m_dataFile(baseName + ".data"),
+    m_indexFile(baseName + ".idx"),
+    m_fd(-1),
+    m_indexFd(-1),
+    m_buffer(nullptr),
+    m_capacity(0),
+    m_length(0),
+    m_start(start),
+    m_keep(false),
+    m_compacted(false),
+    m_writebackPosition(0),
+    m_blockStart(0) {
+    m_creationTime = roboTV::currentTimeMillis();
+}
+
+TimeShiftSegment::~TimeShiftSegment() {
+    close();
+
+    if(!m_keep) {
+        unlink(m_dataFile.c_str());
+        unlink(m_indexFile.c_str());
+    }
+}
+
+bool TimeShiftSegment::create(off_t capacity) {
+    m_fd = ::open(m_dataFile.c_str(), O_CREAT | O_TRUNC | O_RDWR | O_NOATIME, 0644);
+
+    if(m_fd == -1) {
+        esyslog("Failed to create timeshift segment %s !", m_dataFile.c_str());
+        return false;
+    }
+
+    m_indexFd = ::open(m_indexFile.c_str(), O_CREAT | O_TRUNC | O_WRONLY | O_APPEND, 0644);
+
+    if(m_indexFd == -1) {
+        esyslog("Failed to create timeshift index %s !", m_indexFile.c_str());
+        close();
+        return false;
+    }
+
+    m_capacity = capacity;
+    m_length = 0;
+
+    int rc = posix_fallocate(m_fd, 0, capacity);
+
+    // a sparse file must not be mapped, running out of disk space
+    // would raise SIGBUS when writing to the mapping
+    // -> use pwrite (which reports ENOSPC)
+    if(rc != 0) {
+        dsyslog("unable to pre-allocate %li bytes for timeshift segment", capacity);
+        dsyslog("ERROR: %s (status = %i)", strerror(rc), rc);
+
+        m_block.reserve(BlockSize);
+        return true;
+    }
+
+    // map the segment into memory
+    // (fall back to pread / pwrite if the address space is exhausted)
+    void* buffer = mmap(nullptr, (size_t)capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+
+    if(buffer == MAP_FAILED) {
+        esyslog("unable to map timeshift segment: %s", strerror(errno));
+        m_block.reserve(BlockSize);
+        return true;
+    }
+
+    madvise(buffer, (size_t)capacity, MADV_SEQUENTIAL);
+    m_buffer = (uint8_t*)buffer;
+
+    return true;
+}
+
+bool TimeShiftSegment::open() {
+    m_fd = ::open(m_dataFile.c_str(), O_RDONLY | O_NOATIME);
+
+    if(m_fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+
+    if(fstat(m_fd, &st) == -1) {
+        close();
+        return false;
+    }
+
+    // sealed segments can't be extended
+    m_creationTime = std::chrono::milliseconds((int64_t)st.st_mtime * 1000);
+    m_capacity = st.st_size;
+    m_length = st.st_size;
+    m_blockStart = st.st_size;
+    m_keep = true;
+
+    if(m_capacity == 0) {
+        return true;
+    }
+
+    void* buffer = mmap(nullptr, (size_t)m_capacity, PROT_READ, MAP_SHARED, m_fd, 0);
+
+    if(buffer != MAP_FAILED) {
+        m_buffer = (uint8_t*)buffer;
+    }
+
+    return true;
+}
+
+void TimeShiftSegment::close() {
+    flushBlock();
+
+    if(m_buffer != nullptr) {
+        munmap(m_buffer, (size_t)m_capacity);
+        m_buffer = nullptr;
+    }
+
+    if(m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+    }
+
+    if(m_indexFd != -1) {
+        ::close(m_indexFd);
+        m_indexFd = -1;
+    }
+}
+
+bool TimeShiftSegment::write(MsgPacket* p) {
+    off_t length = m_length.load();
+    off_t packetLength = p->getPacketLength();
+
+    if(m_fd == -1 || length + packetLength > m_capacity) {
+        return false;
+    }
+
+    if(m_buffer != nullptr) {
+        memcpy(m_buffer + length, p->getPacket(), (size_t)packetLength);
+    }
+    else {
+        std::lock_guard<std::mutex> lock(m_blockMutex);
+
+        const uint8_t* data = p->getPacket();
+        off_t remaining = packetLength;
+
+        // fill block buffer and write completed blocks
+        while(remaining > 0) {
+            off_t count = std::min(remaining, BlockSize - (off_t)m_block.size());
+
+            m_block.insert(m_block.end(), data, data + count);
+            data += count;
+            remaining -= count;
+
+            if((off_t)m_block.size() == BlockSize && !flushBlock()) {
+                // e.g. disk full -> drop the partial packet and close the segment
+                m_block.resize((size_t)std::max((off_t)0, length - m_blockStart));
+                m_capacity = length;
+                return false;
+            }
+        }
+    }
+
+    // publish packet
+    m_length = length + packetLength;
+    return true;
+}
+
+MsgPacket* TimeShiftSegment::read(off_t offset) {
+    off_t available = m_length.load() - offset;
+
+    if(available < (off_t)MsgPacket::HeaderLength) {
+        return nullptr;
+    }
+
+    if(m_buffer != nullptr) {
+        return MsgPacket::readbuffer(m_buffer + offset, (uint32_t)available);
+    }
+
+    // not mapped, read header to get the length of the packet
+    std::lock_guard<std::mutex> lock(m_blockMutex);
+    uint8_t header[MsgPacket::HeaderLength];
+
+    if(!readData(offset, header, sizeof(header))) {
+        return nullptr;
+    }
+
+    uint32_t payloadLength = 0;
+    memcpy(&payloadLength, &header[MsgPacket::PayloadLengthPos], sizeof(payloadLength));
+    payloadLength = be32toh(payloadLength);
+
+    off_t length = sizeof(header) + payloadLength;
+
+    if(length > available) {
+        return nullptr;
+    }
+
+    std::vector<uint8_t> data((size_t)length);
+
+    if(!readData(offset, data.data(), length)) {
+        return nullptr;
+    }
+
+    return MsgPacket::readbuffer(data.data(), (uint32_t)length);
+}
+
+bool TimeShiftSegment::readData(off_t offset, uint8_t* data, off_t length) {
+    // m_blockMutex must be locked by the caller
+
+    // written part
+    if(offset < m_blockStart) {
+        off_t count = std::min(length, m_blockStart - offset);
+
+        if(pread(m_fd, data, (size_t)count, offset) != count) {
+            return false;
+        }
+
+        data += count;
+        offset += count;
+        length -= count;
+    }
+
+    if(length == 0) {
+        return true;
+    }
+
+    // remaining part from the block buffer
+    if(offset + length > m_blockStart + (off_t)m_block.size()) {
+        return false;
+    }
+
+    memcpy(data, m_block.data() + (offset - m_blockStart), (size_t)length);
+    return true;
+}
+
+bool TimeShiftSegment::flushBlock() {
+    // m_blockMutex must be locked by the caller (or no readers attached)
+    if(m_block.empty() || m_fd == -1) {
+        return true;
+    }
+
+    if(pwrite(m_fd, m_block.data(), m_block.size(), m_blockStart) != (ssize_t)m_block.size()) {
+        esyslog("Failed to write timeshift block: %s", strerror(errno));
+        return false;
+    }
+
+    m_blockStart += m_block.size();
+    m_block.clear();
+
+    return true;
+}
+
+bool TimeShiftSegment::nextWriteback(off_t& from, off_t& to) {
+    off_t end = m_length.load() & ~(BlockSize - 1);
+
+    if(end <= m_writebackPosition) {
+        return false;
+    }
+
+    from = m_writebackPosition;
+    to = end;
+
+    m_writebackPosition = end;
+    return true;
+}
+
+void TimeShiftSegment::writeback(off_t from, off_t to) {
+    if(m_fd == -1) {
+        return;
+    }
+
+#ifdef SYNC_FILE_RANGE_WRITE
+    sync_file_range(m_fd, from, to - from, SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+bool TimeShiftSegment::addIndex(const IndexEntry& entry) {
+    if(m_indexFd == -1) {
+        return false;
+    }
+
+    return (::write(m_indexFd, &entry, sizeof(entry)) == sizeof(entry));
+}
+
+std::vector<TimeShiftSegment::IndexEntry> TimeShiftSegment::loadIndex() {
+    std::vector<IndexEntry> list;
+
+    int fd = ::open(m_indexFile.c_str(), O_RDONLY);
+
+    if(fd == -1) {
+        return list;
+    }
+
+    IndexEntry entry;
+
+    while(::read(fd, &entry, sizeof(entry)) == sizeof(entry)) {
+        // skip entries of a partially written segment
+        if((off_t)entry.offset >= m_length.load()) {
+            break;
+        }
+
+        list.push_back(entry);
+    }
+
+    ::close(fd);
+    return list;
+}
+
+void TimeShiftSegment::truncate() {
+    flushBlock();
+
+    off_t length = m_length.load();
+
+    if(m_fd == -1 || m_capacity == length) {
+        return;
+    }
+
+    bool mapped = (m_buffer != nullptr);
+
+    if(mapped) {
+        munmap(m_buffer, (size_t)m_capacity);
+        m_buffer = nullptr;
+    }
+
+    if(ftruncate(m_fd, length) == -1) {
+        esyslog("Failed to truncate timeshift segment %s !", m_dataFile.c_str());
+    }
+
+    m_capacity = length;
+    m_blockStart = length;
+
+    // no more writes
+    if(mapped && length > 0) {
+        void* buffer = mmap(nullptr, (size_t)length, PROT_READ, MAP_SHARED, m_fd, 0);
+
+        if(buffer != MAP_FAILED) {
+            m_buffer = (uint8_t*)buffer;
+        }
+    }
+}
+
+bool TimeShiftSegment::replace(TimeShiftSegment& segment) {
+    // the data file commits the replacement
+    // (a remaining index file is moved by TimeShiftScheduler::findSegments)
+    if(::rename(m_dataFile.c_str(), segment.m_dataFile.c_str()) == -1) {
+        esyslog("Failed to replace timeshift segment %s: %s", segment.m_dataFile.c_str(), strerror(errno));
+        return false;
+    }
+
+    m_dataFile = segment.m_dataFile;
+
+    if(::rename(m_indexFile.c_str(), segment.m_indexFile.c_str()) == -1) {
+        esyslog("Failed to replace timeshift index %s: %s", segment.m_indexFile.c_str(), strerror(errno));
+
+        // the old index doesn't match anymore
+        unlink(segment.m_indexFile.c_str());
+        unlink(m_indexFile.c_str());
+    }
+
+    m_indexFile = segment.m_indexFile;
+    m_compacted = true;
+
+    // the files belong to this segment now
+    segment.m_keep = true;
+
+    return true;
+}
+
+void TimeShiftSegment::seal() {
+    truncate();
+    m_keep = true;
+}
+
+void TimeShiftSegment::sync() {
+    if(m_fd != -1 && fdatasync(m_fd) != 0) {
+        esyslog("Failed to sync timeshift segment !");
+    }
+}
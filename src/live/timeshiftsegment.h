@@ -0,0 +1,221 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_TIMESHIFTSEGMENT_H
+#define ROBOTV_TIMESHIFTSEGMENT_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class MsgPacket;
+
+/**
+ * Timeshift segment.
+ * A fixed-size, append-only file of stream packets with a keyframe index sidecar
+ * (".idx"). Segments are written once, read concurrently by all readers of a live
+ * queue and removed as a whole when the timeshift buffer is trimmed.
+ *
+ * Data is written in blocks of BlockSize bytes. Segments that can't be
+ * preallocated or mapped into memory coalesce packets in a block buffer and
+ * write complete blocks.
+ */
+class TimeShiftSegment {
+public:
+
+    static const off_t BlockSize = 1024 * 1024;
+
+    // keyframe index record (as stored in the sidecar file)
+    struct IndexEntry {
+        uint64_t offset;
+        int64_t wallclockTime;
+        int64_t pts;
+    };
+
+    /**
+     * Construct a segment.
+     * @param baseName filename of the segment (without extension)
+     * @param start stream position of the first byte in the segment
+     */
+    TimeShiftSegment(const std::string& baseName, uint64_t start);
+
+    virtual ~TimeShiftSegment();
+
+    /**
+     * Create a new (empty) segment.
+     * @param capacity size of the segment in bytes
+     * @return true on success
+     */
+    bool create(off_t capacity);
+
+    /**
+     * Open an existing segment (read only).
+     * @return true on success
+     */
+    bool open();
+
+    /**
+     * Append a packet to the segment.
+     * Must only be called from the writer.
+     * @param p pointer to packet
+     * @return false if the packet doesn't fit into the segment
+     */
+    bool write(MsgPacket* p);
+
+    /**
+     * Read a packet.
+     * @param offset offset of the packet within the segment
+     * @return the packet (ownership is transferred) or nullptr
+     */
+    MsgPacket* read(off_t offset);
+
+    bool addIndex(const IndexEntry& entry);
+
+    std::vector<IndexEntry> loadIndex();
+
+    /**
+     * Truncate the segment to it's current length.
+     * Must not be called while readers are attached.
+     */
+    void truncate();
+
+    /**
+     * Truncate the segment and keep it on disk after destruction.
+     * Must not be called while readers are attached.
+     */
+    void seal();
+
+    /**
+     * Replace the files of another segment with the files of this segment.
+     * The other segment keeps reading from the replaced (unlinked) files and
+     * won't remove any files on destruction.
+     * @param segment segment to replace (in the same directory)
+     * @return true on success
+     */
+    bool replace(TimeShiftSegment& segment);
+
+    /**
+     * Get the next range of completed blocks that need to be written back.
+     * Must only be called from the writer.
+     * @param from resulting start offset
+     * @param to resulting end offset
+     * @return true if there are completed blocks
+     */
+    bool nextWriteback(off_t& from, off_t& to);
+
+    /**
+     * Start writeback of a range (non-blocking).
+     */
+    void writeback(off_t from, off_t to);
+
+    /**
+     * Sync the segment to disk (blocking).
+     */
+    void sync();
+
+    uint64_t getStart() const {
+        return m_start;
+    }
+
+    uint64_t getEnd() const {
+        return m_start + m_length.load();
+    }
+
+    off_t getLength() const {
+        return m_length.load();
+    }
+
+    bool fits(off_t length) const {
+        return m_length.load() + length <= m_capacity;
+    }
+
+    std::chrono::milliseconds getCreationTime() const {
+        return m_creationTime;
+    }
+
+    // filename without directory and extension
+    std::string getName() const {
+        std::string name = m_dataFile.substr(m_dataFile.rfind('/') + 1);
+        return name.substr(0, name.size() - 5);
+    }
+
+    // directory of the segment files
+    std::string getDirectory() const {
+        return m_dataFile.substr(0, m_dataFile.rfind('/'));
+    }
+
+    bool isCompacted() const {
+        return m_compacted;
+    }
+
+protected:
+
+    void close();
+
+    bool flushBlock();
+
+    bool readData(off_t offset, uint8_t* data, off_t length);
+
+private:
+
+    std::string m_dataFile;
+
+    std::string m_indexFile;
+
+    int m_fd;
+
+    int m_indexFd;
+
+    uint8_t* m_buffer;
+
+    off_t m_capacity;
+
+    std::atomic<off_t> m_length;
+
+    uint64_t m_start;
+
+    bool m_keep;
+
+    bool m_compacted;
+
+    std::chrono::milliseconds m_creationTime;
+
+    // offset of the first block not written back yet
+    off_t m_writebackPosition;
+
+    // block buffer (unmapped segments only)
+    std::vector<uint8_t> m_block;
+
+    off_t m_blockStart;
+
+    std::mutex m_blockMutex;
+
+};
+
+#endif // ROBOTV_TIMESHIFTSEGMENT_H
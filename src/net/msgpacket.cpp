@@ -228,6 +228,22 @@ void MsgPacket::unreserve(uint32_t length) {
     m_usage -= length;
 }
 
+bool MsgPacket::adopt(uint8_t* buffer, uint32_t size) {
+    if(m_packet == NULL || buffer == NULL || size < HeaderLength) {
+        return false;
+    }
+
+    memcpy(buffer, m_packet, HeaderLength);
+    free(m_packet);
+
+    m_packet = buffer;
+    m_size = size;
+    m_usage = HeaderLength;
+    m_readposition = HeaderLength;
+
+    return true;
+}
+
 uint8_t* MsgPacket::consume(uint32_t length) {
     if(m_size < m_readposition + length) {
         return NULL;
@@ -304,6 +320,10 @@ uint32_t MsgPacket::getPacketLength() {
     return m_usage;
 }
 
+uint32_t MsgPacket::getAllocatedLength() {
+    return m_size;
+}
+
 uint8_t* MsgPacket::getPayload() {
     return m_packet + HeaderLength;
 }
@@ -534,6 +554,45 @@ MsgPacket* MsgPacket::read(int fd, bool& closed, int timeout_ms) {
     return p;
 }
 
+MsgPacket* MsgPacket::readbuffer(const uint8_t* data, uint32_t length) {
+    if(length < HeaderLength) {
+        return NULL;
+    }
+
+    MsgPacket* p = new MsgPacket(0, 0, 1);
+    memcpy(p->m_packet, data, HeaderLength);
+
+    // header validation
+    uint32_t sync = be32toh(p->readPacket<uint32_t>(SyncPos));
+
+    if(sync != 0xAAAAAA || p->getCheckSum() != crc32(p->m_packet, CheckSumPos)) {
+        delete p;
+        return NULL;
+    }
+
+    uint32_t datalen = be32toh(p->readPacket<uint32_t>(PayloadLengthPos));
+
+    if(datalen > length - HeaderLength) {
+        delete p;
+        return NULL;
+    }
+
+    // copy payload
+    if(datalen > 0) {
+        uint8_t* payload = p->reserve(datalen);
+
+        if(payload == NULL) {
+            delete p;
+            return NULL;
+        }
+
+        memcpy(payload, data + HeaderLength, datalen);
+    }
+
+    p->m_payloadchecksum = (p->getPayloadCheckSum() != 0);
+    return p;
+}
+
 bool MsgPacket::readstream(std::istream& in, MsgPacket& p) {
     uint8_t* header = p.getPacket();
 
@@ -172,6 +172,18 @@ public:
     */
     uint8_t* consume(uint32_t length);
 
+    /**
+    Adopt packet memory.
+    Takes over a malloc'ed memory area as packet buffer. The packet header is
+    copied into the buffer, the payload is cleared. Data already placed behind
+    the header can be taken over into the payload with reserve().
+
+    @param buffer		malloc'ed memory area (will be freed by the packet)
+    @param size			size of the memory area (at least HeaderLength bytes)
+    @return true on success / false if the buffer is too small
+    */
+    bool adopt(uint8_t* buffer, uint32_t size);
+
     /**
     Clear payload data.
     Remove payload data from packet
@@ -314,6 +326,14 @@ public:
     */
     uint32_t getPacketLength();
 
+    /**
+    Get allocated size.
+    Returns the size of the memory allocated for the packet (including unused space)
+
+    @return allocated size of the packet
+    */
+    uint32_t getAllocatedLength();
+
     /**
     Get pointer to payload data.
     Returns a pointer to the packets packets payload data
@@ -469,6 +489,17 @@ public:
 
     static bool readstream(std::istream& in, MsgPacket& p);
 
+    /**
+    Create packet from memory.
+    Create a new packet from a memory region holding a complete packet (header + payload).
+    Only the header checksum will be validated.
+
+    @param	data		pointer to packet data
+    @param	length		number of bytes available at "data"
+    @return pointer to new packet or NULL if there isn't a valid packet
+    */
+    static MsgPacket* readbuffer(const uint8_t* data, uint32_t length);
+
     MsgPacket* clone();
 
     enum {
@@ -26,9 +26,12 @@
 #include <tools/time.h>
 #include "packetplayer.h"
 
-#define MIN_PACKET_SIZE (128 * 1024)
+// target latency of a stream packet
+#define PACKET_LATENCY std::chrono::milliseconds(1000)
 
-PacketPlayer::PacketPlayer(const cRecording* rec) : RecPlayer(rec->FileName()) {
+#define MAX_PACKET_SIZE (256 * 1024)
+
+PacketPlayer::PacketPlayer(const cRecording* rec) : RecPlayer(rec->FileName()), m_aggregator(PACKET_LATENCY, MAX_PACKET_SIZE) {
     m_index = new cIndexFile(rec->FileName(), false);
     m_recording = rec;
     m_position = 0;
@@ -111,10 +114,7 @@ MsgPacket* PacketPlayer::getNextPacket() {
     // advance to next block
     m_position += bufferSize;
 
-    for(int i = 0; i < count; i++) {
-        putTsPacket(p, m_position);
-        p += TS_SIZE;
-    }
+    putTsPackets(p, count, m_position);
 
     // currently there isn't any packet available
     return nullptr;
@@ -163,10 +163,11 @@ MsgPacket* PacketPlayer::requestPacket() {
         uint32_t length = p->getPayloadLength();
         m_streamPacket->put_Blob(data, length);
 
+        // send payload packet if it's big enough
+        bool send = m_aggregator.add(p, m_streamPacket->getPayloadLength());
         delete p;
 
-        // send payload packet if it's big enough
-        if(m_streamPacket->getPayloadLength() >= MIN_PACKET_SIZE) {
+        if(send) {
             MsgPacket* result = m_streamPacket;
             m_streamPacket = nullptr;
             return result;
@@ -194,6 +195,8 @@ void PacketPlayer::reset() {
     delete m_streamPacket;
     m_streamPacket = nullptr;
 
+    m_aggregator.reset();
+
     // remove pending packets
     clearQueue();
 }
@@ -31,6 +31,7 @@
 #include "robotv/StreamPacketProcessor.h"
 #include "recordings/recplayer.h"
 #include "net/msgpacket.h"
+#include "tools/packetaggregator.h"
 
 #include "vdr/remux.h"
 #include <deque>
@@ -83,6 +84,8 @@ private:
 
     MsgPacket* m_streamPacket = NULL;
 
+    roboTV::PacketAggregator m_aggregator;
+
     std::chrono::milliseconds m_startTime;
 
     std::chrono::milliseconds m_endTime;
@@ -88,6 +88,42 @@ StreamBundle StreamPacketProcessor::createFromPatPmt(const cPatPmtParser* patpmt
 }
 
 bool StreamPacketProcessor::putTsPacket(uint8_t *data, int64_t position) {
+    int pid = TsPid(data);
+
+    // only PAT and PMT packets need to be parsed
+    if(pid == PATPID || m_parser.IsPmtPid(pid)) {
+        processPatPmt(data);
+    }
+
+    // put packets into demuxer
+    return m_demuxers.processTsPacket(data, position);
+}
+
+size_t StreamPacketProcessor::putTsPackets(uint8_t* data, size_t count, int64_t position) {
+    size_t processed = 0;
+    size_t start = 0;
+
+    for(size_t i = 0; i < count; i++) {
+        uint8_t* packet = data + i * TS_SIZE;
+        int pid = TsPid(packet);
+
+        if(pid != PATPID && !m_parser.IsPmtPid(pid)) {
+            continue;
+        }
+
+        // the PAT / PMT may change the demuxers,
+        // process all packets in front of it first
+        processed += m_demuxers.processTsPackets(data + start * TS_SIZE, i - start, position);
+        processPatPmt(packet);
+
+        start = i;
+    }
+
+    processed += m_demuxers.processTsPackets(data + start * TS_SIZE, count - start, position);
+    return processed;
+}
+
+void StreamPacketProcessor::processPatPmt(uint8_t* data) {
     if(m_parser.ParsePatPmt(data, TS_SIZE)) {
         int pmtVersion = 0;
         int patVersion = 0;
@@ -96,23 +132,22 @@ bool StreamPacketProcessor::putTsPacket(uint8_t *data, int64_t position) {
             if(pmtVersion > m_pmtVersion) {
                 isyslog("found new PAT/PMT version (%i/%i)", patVersion, pmtVersion);
 
-                cleanupQueue();
-                m_demuxers.clear();
-
                 m_pmtVersion = pmtVersion;
                 m_patVersion = patVersion;
-                m_requestStreamChange = true;
 
                 // update demuxers from new PMT
-                isyslog("updating demuxers");
+                // (demuxers of unchanged streams keep their state)
                 StreamBundle streamBundle = createFromPatPmt(&m_parser);
-                m_demuxers.updateFrom(&streamBundle);
+
+                if(m_demuxers.updateFrom(&streamBundle)) {
+                    isyslog("streams changed - demuxers updated");
+
+                    cleanupQueue();
+                    m_requestStreamChange = true;
+                }
             }
         }
     }
-
-    // put packets into demuxer
-    return m_demuxers.processTsPacket(data, position);
 }
 
 void StreamPacketProcessor::cleanupQueue() {
@@ -137,6 +172,26 @@ void StreamPacketProcessor::reset() {
     cleanupQueue();
 }
 
+bool StreamPacketProcessor::fastStart() {
+    if(!m_demuxers.isReady()) {
+        return false;
+    }
+
+    isyslog("fast start with cached stream information");
+
+    for(auto i : m_demuxers) {
+        isyslog("%s", i->info().c_str());
+
+        // the parsers will check the cached decoder data
+        i->verifyVideoDecoderData();
+    }
+
+    m_requestStreamChange = false;
+
+    onPacket(createStreamChangePacket(m_demuxers), StreamInfo::Content::STREAMINFO, 0);
+    return true;
+}
+
 void StreamPacketProcessor::onStreamPacket(TsDemuxer::StreamPacket *p) {
     // skip empty packets
     if(p == nullptr || p->size == 0 || p->data == nullptr) {
@@ -173,6 +228,17 @@ void StreamPacketProcessor::onStreamPacket(TsDemuxer::StreamPacket *p) {
     MsgPacket* packet = new MsgPacket(ROBOTV_STREAM_MUXPKT, ROBOTV_CHANNEL_STREAM);
     packet->disablePayloadCheckSum();
 
+    // take over the payload buffer of the parser (if the payload is in place)
+    bool adopted = false;
+
+    if(p->buffer != nullptr &&
+            p->data == p->buffer + getPacketHeadroom() &&
+            p->bufferSize >= getPacketHeadroom() + p->size &&
+            packet->adopt(p->buffer, (uint32_t)p->bufferSize)) {
+        p->buffer = nullptr;
+        adopted = true;
+    }
+
     // write stream data
     packet->put_U16((uint16_t)p->pid);
 
@@ -185,7 +251,13 @@ void StreamPacketProcessor::onStreamPacket(TsDemuxer::StreamPacket *p) {
 
     // write payload into stream packet
     packet->put_U32((uint32_t)p->size);
-    packet->put_Blob(p->data, (uint32_t)p->size);
+
+    if(adopted) {
+        packet->reserve((uint32_t)p->size);
+    }
+    else {
+        packet->put_Blob(p->data, (uint32_t)p->size);
+    }
 
     // add timestamp (wallclock time in ms)
     packet->put_S64(getCurrentTime(p));
@@ -205,6 +277,11 @@ void StreamPacketProcessor::onStreamPacket(TsDemuxer::StreamPacket *p) {
     onPacket(packet, p->content, p->pts);
 }
 
+int StreamPacketProcessor::getPacketHeadroom() {
+    // packet header + pid, pts, dts, duration, size
+    return MsgPacket::HeaderLength + 2 + 8 + 8 + 4 + 4;
+}
+
 void StreamPacketProcessor::onStreamChange() {
     if(!m_requestStreamChange) {
         isyslog("stream change requested");
@@ -48,6 +48,17 @@ public:
      */
     bool putTsPacket(uint8_t* data, int64_t position = 0);
 
+    /**
+     * Put a block of TS packets.
+     * Processes consecutive transport stream packets in one go. PAT and PMT
+     * packets are handled in order, all other packets are grouped by pid.
+     * @param data pointer to the first TS packet
+     * @param count number of TS packets
+     * @param position a position that will be passed through to all resulting StreamPackets
+     * @return the number of packets processed by the demuxers
+     */
+    size_t putTsPackets(uint8_t* data, size_t count, int64_t position = 0);
+
     /**
      * Reset the packet processor.
      * This function resets the internal state of the processor. Should be called
@@ -82,10 +93,22 @@ protected:
 
     void onStreamChange() override;
 
+    int getPacketHeadroom() override;
+
     StreamBundle createFromPatPmt(const cPatPmtParser* patpmt);
 
     virtual MsgPacket* createStreamChangePacket(DemuxerBundle& bundle);
 
+    /**
+     * Start with the current stream information of the demuxers.
+     * Sends the stream change immediately if the stream information of all
+     * demuxers is known (e.g. from the channel cache). The demuxers of
+     * streams matching the PMT will be kept, a new stream change is sent if
+     * the parsers detect a difference.
+     * @return true if the stream change has been sent
+     */
+    bool fastStart();
+
     inline DemuxerBundle& getDemuxers() {
         return m_demuxers;
     }
@@ -94,6 +117,8 @@ protected:
 
 private:
 
+    void processPatPmt(uint8_t* data);
+
     cPatPmtParser m_parser;
 
     DemuxerBundle m_demuxers;
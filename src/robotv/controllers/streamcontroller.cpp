@@ -37,7 +37,15 @@ StreamController::StreamController(const StreamController& orig) {
 }
 
 StreamController::~StreamController() {
+    stop();
+}
+
+void StreamController::stop() {
+    delete m_preview;
+    m_preview = nullptr;
+
     stopStreaming();
+    m_preTuner.clear();
 }
 
 MsgPacket* StreamController::process(MsgPacket* request) {
@@ -61,6 +69,15 @@ MsgPacket* StreamController::process(MsgPacket* request) {
 
         case ROBOTV_CHANNELSTREAM_SEEK:
             return processSeek(request);
+
+        case ROBOTV_CHANNELSTREAM_CREDIT:
+            return processCredit(request);
+
+        case ROBOTV_CHANNELSTREAM_SELECT:
+            return processSelect(request);
+
+        case ROBOTV_CHANNELSTREAM_PREVIEW:
+            return processPreview(request);
     }
 
     return nullptr;
@@ -121,6 +138,9 @@ MsgPacket* StreamController::processOpen(MsgPacket* request) {
     if(status == ROBOTV_RET_OK) {
         isyslog("--------------------------------------");
         isyslog("Started streaming of channel %s (priority %i)", channel->Name(), priority);
+
+        // warm up adjacent channels
+        m_preTuner.update(Channels, channel, m_language, m_langStreamType);
     }
     else {
         time_t now = time(nullptr);
@@ -140,6 +160,7 @@ MsgPacket* StreamController::processOpen(MsgPacket* request) {
 
 MsgPacket* StreamController::processClose(MsgPacket* request) {
     stopStreaming();
+    m_preTuner.clear();
     return createResponse(request);
 }
 
@@ -151,13 +172,16 @@ MsgPacket* StreamController::processRequest(MsgPacket* request) {
     MsgPacket* p = nullptr;
 
     int64_t start = roboTV::currentTimeMillis().count();
+    int64_t elapsed = 0;
 
-    while(p == nullptr && (roboTV::currentTimeMillis().count() - start) < 500) {
+    while(p == nullptr && elapsed < 500) {
         p = m_streamer->requestPacket();
 
         if(p == nullptr) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            m_streamer->waitForData(std::chrono::milliseconds(500 - elapsed));
         }
+
+        elapsed = roboTV::currentTimeMillis().count() - start;
     }
 
     if(p == nullptr) {
@@ -195,9 +219,131 @@ void StreamController::processChannelChange(const cChannel* Channel) {
     }
 }
 
+MsgPacket* StreamController::processCredit(MsgPacket* request) {
+    MsgPacket* response = createResponse(request);
+
+    // push mode needs a capable client
+    if(request->getProtocolVersion() < ROBOTV_PROTOCOLVERSION_PUSH) {
+        response->put_U32(ROBOTV_RET_NOTSUPPORTED);
+        return response;
+    }
+
+    uint32_t credits = request->get_U32();
+
+    if(!m_push) {
+        isyslog("LIVESTREAM: push mode enabled (%u credits)", credits);
+    }
+
+    m_push = true;
+    m_credits += credits;
+    m_protocolVersion = request->getProtocolVersion();
+
+    response->put_U32(ROBOTV_RET_OK);
+    return response;
+}
+
+MsgPacket* StreamController::processSelect(MsgPacket* request) {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if(m_streamer == nullptr) {
+        return nullptr;
+    }
+
+    // selected streams (including video), none for all streams
+    std::set<int> pids;
+    int count = request->get_U8();
+
+    for(int i = 0; i < count && !request->eop(); i++) {
+        pids.insert((int)request->get_U32());
+    }
+
+    m_streamer->selectStreams(pids);
+
+    MsgPacket* response = createResponse(request);
+    response->put_U32(ROBOTV_RET_OK);
+    return response;
+}
+
+MsgPacket* StreamController::processPreview(MsgPacket* request) {
+    uint32_t interval = request->get_U32();
+    int count = request->get_U8();
+
+    // stop running preview
+    delete m_preview;
+    m_preview = nullptr;
+
+    MsgPacket* response = createResponse(request);
+
+    if(count == 0) {
+        response->put_U32(ROBOTV_RET_OK);
+        response->put_U8(0);
+        return response;
+    }
+
+    LOCK_CHANNELS_READ;
+    std::list<const cChannel*> channels;
+
+    for(int i = 0; i < count && !request->eop(); i++) {
+        uint32_t uid = request->get_U32();
+        const cChannel* channel = roboTV::Hash::findChannelByUid(Channels, uid);
+
+        if(channel != nullptr) {
+            channels.push_back(channel);
+        }
+    }
+
+    int status = ROBOTV_RET_OK;
+    m_preview = PreviewReceiver::create(m_parent, channels, std::chrono::milliseconds(interval), LIVEPRIORITY, status);
+
+    response->put_U32((uint32_t)status);
+
+    if(m_preview == nullptr) {
+        response->put_U8(0);
+        return response;
+    }
+
+    // channels in the preview
+    std::list<uint32_t> uids = m_preview->getChannels();
+    response->put_U8((uint8_t)uids.size());
+
+    for(auto uid: uids) {
+        response->put_U32(uid);
+    }
+
+    return response;
+}
+
+void StreamController::pushPackets() {
+    std::lock_guard<std::mutex> lock(m_lock);
+
+    if(!m_push || m_streamer == nullptr) {
+        return;
+    }
+
+    // don't spend credits on empty packets while paused
+    while(m_credits > 0) {
+        MsgPacket* p = m_streamer->requestPacket(false);
+
+        if(p == nullptr) {
+            return;
+        }
+
+        p->setType(ROBOTV_CHANNEL_STREAM);
+        p->setMsgID(ROBOTV_STREAM_MUXPKT);
+        p->setProtocolVersion(m_protocolVersion);
+
+        m_parent->queueMessage(p);
+        m_credits--;
+    }
+}
+
 int StreamController::startStreaming(const cChannel* channel, int32_t priority) {
     std::lock_guard<std::mutex> lock(m_lock);
 
+    // the client grants new credits for every stream
+    m_push = false;
+    m_credits = 0;
+
     m_streamer = new LiveStreamer(m_parent, priority);
     m_streamer->setLanguage(m_language.c_str(), m_langStreamType);
 
@@ -28,6 +28,8 @@
 #include <mutex>
 
 #include "live/livestreamer.h"
+#include "live/pretuner.h"
+#include "live/previewreceiver.h"
 #include "controller.h"
 
 class RoboTvClient;
@@ -44,6 +46,19 @@ public:
 
     void processChannelChange(const cChannel* Channel);
 
+    /**
+     * Push pending stream packets to the client.
+     * Only active in push mode (a client granted credits).
+     * Must be called from the client thread.
+     */
+    void pushPackets();
+
+    /**
+     * Stop live streaming and the channel preview.
+     * No stream data will be delivered to the client afterwards.
+     */
+    void stop();
+
 protected:
 
     MsgPacket* processOpen(MsgPacket* request);
@@ -58,6 +73,12 @@ protected:
 
     MsgPacket* processSeek(MsgPacket* request);
 
+    MsgPacket* processCredit(MsgPacket* request);
+
+    MsgPacket* processSelect(MsgPacket* request);
+
+    MsgPacket* processPreview(MsgPacket* request);
+
 private:
 
     StreamController(const StreamController& orig);
@@ -72,8 +93,19 @@ private:
 
     LiveStreamer* m_streamer = NULL;
 
+    PreTuner m_preTuner;
+
+    PreviewReceiver* m_preview = NULL;
+
     std::mutex m_lock;
 
+    // push mode: number of packets the client is able to receive
+    uint32_t m_credits = 0;
+
+    bool m_push = false;
+
+    uint16_t m_protocolVersion = 0;
+
     RoboTvClient* m_parent;
 };
 
@@ -116,6 +116,8 @@ const char** PluginRoboTVServer::SVDRPHelpPages(void) {
         "    List all channels activated for roboTV in JSON format.",
         "LSEJ channelUid | channelNumber\n"
         "    List upcoming EPG entries of the channel.",
+        "LSLJ\n"
+        "    List all running live streams in JSON format.",
         NULL
     };
 
@@ -124,7 +126,15 @@ const char** PluginRoboTVServer::SVDRPHelpPages(void) {
 
 cString PluginRoboTVServer::SVDRPCommand(const char* Command, const char* Option, int& ReplyCode) {
     // Process SVDRP commands this plugin implements
-    return m_channels.SVDRPCommand(Command, Option, ReplyCode);
+    int code = ReplyCode;
+    cString result = m_channels.SVDRPCommand(Command, Option, ReplyCode);
+
+    if(ReplyCode != 500) {
+        return result;
+    }
+
+    ReplyCode = code;
+    return m_live.SVDRPCommand(Command, Option, ReplyCode);
 }
 
 VDRPLUGINCREATOR(PluginRoboTVServer); // Don't touch this!
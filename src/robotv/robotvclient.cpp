@@ -22,7 +22,11 @@
  *
  */
 
+#include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #include <map>
@@ -41,6 +45,12 @@ RoboTvClient::RoboTvClient(int fd, unsigned int id) : m_id(id), m_socket(fd),
     m_recordingController(this),
     m_timerController(this) {
 
+    m_wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(m_wakeup == -1) {
+        esyslog("failed to create wakeup event: %s", strerror(errno));
+    }
+
     m_controllers = {
         &m_streamController,
         &m_recordingController,
@@ -59,11 +69,24 @@ RoboTvClient::RoboTvClient(int fd, unsigned int id) : m_id(id), m_socket(fd),
 RoboTvClient::~RoboTvClient() {
     // shutdown connection
     shutdown(m_socket, SHUT_RDWR);
+    wakeup();
     Cancel(10);
 
     // close connection
     close(m_socket);
 
+    // receivers must not wakeup the client anymore
+    m_streamController.stop();
+
+    {
+        std::lock_guard<std::mutex> lock(m_wakeupLock);
+
+        if(m_wakeup != -1) {
+            close(m_wakeup);
+            m_wakeup = -1;
+        }
+    }
+
     // delete messagequeue
     {
         std::lock_guard<std::mutex> lock(m_queueLock);
@@ -83,7 +106,12 @@ void RoboTvClient::Action(void) {
 
     while(Running()) {
 
+        // push stream packets
+        m_streamController.pushPackets();
+
         // send pending messages
+        bool pending = false;
+
         {
             std::lock_guard<std::mutex> lock(m_queueLock);
 
@@ -97,6 +125,44 @@ void RoboTvClient::Action(void) {
                 m_queue.pop_front();
                 delete p;
             }
+
+            pending = !m_queue.empty();
+        }
+
+        // wait for requests or new messages
+        struct pollfd fds[2];
+
+        fds[0].fd = m_socket;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+
+        fds[1].fd = m_wakeup;
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+
+        // without eventfd we have to poll for new messages
+        int timeout = (pending || m_wakeup == -1) ? 10 : 1000;
+        int rc = poll(fds, (m_wakeup != -1) ? 2 : 1, timeout);
+
+        if(rc < 0 && errno != EINTR) {
+            esyslog("poll failed: %s", strerror(errno));
+            break;
+        }
+
+        if(rc <= 0) {
+            continue;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            uint64_t count;
+
+            if(read(m_wakeup, &count, sizeof(count)) != sizeof(count)) {
+                dsyslog("failed to reset wakeup event");
+            }
+        }
+
+        if(fds[0].revents == 0) {
+            continue;
         }
 
         m_request = MsgPacket::read(m_socket, bClosed, 10);
@@ -242,8 +308,27 @@ bool RoboTvClient::processRequest() {
 }
 
 void RoboTvClient::queueMessage(MsgPacket* p) {
-    std::lock_guard<std::mutex> lock(m_queueLock);
-    m_queue.push_back(p);
+    {
+        std::lock_guard<std::mutex> lock(m_queueLock);
+        m_queue.push_back(p);
+    }
+
+    wakeup();
+}
+
+void RoboTvClient::wakeup() {
+    std::lock_guard<std::mutex> lock(m_wakeupLock);
+
+    if(m_wakeup == -1) {
+        return;
+    }
+
+    // EAGAIN: counter saturated, the client thread is awake anyway
+    uint64_t count = 1;
+
+    if(write(m_wakeup, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        dsyslog("failed to wakeup client thread: %s", strerror(errno));
+    }
 }
 
 void RoboTvClient::broadcastMessage(MsgPacket* p) {
@@ -59,6 +59,11 @@ private:
 
     int m_socket;
 
+    // eventfd to wakeup the client thread
+    int m_wakeup;
+
+    std::mutex m_wakeupLock;
+
     MsgPacket* m_request = NULL;
 
     Utf8Conv m_toUtf8;
@@ -113,6 +118,12 @@ public:
 
     void sendStatusMessage(const char* Message);
 
+    /**
+     * Wakeup the client thread.
+     * Pending messages and stream packets will be sent immediately.
+     */
+    void wakeup();
+
     unsigned int getId() const {
         return m_id;
     }
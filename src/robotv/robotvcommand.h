@@ -26,7 +26,10 @@
 #define ROBOTV_COMMAND_H
 
 /** Current RoboTV Protocol Version number */
-#define ROBOTV_PROTOCOLVERSION          9
+#define ROBOTV_PROTOCOLVERSION          10
+
+/** First protocol version with pushed stream packets */
+#define ROBOTV_PROTOCOLVERSION_PUSH     10
 
 
 /** Packet types */
@@ -53,6 +56,9 @@
 #define ROBOTV_CHANNELSTREAM_PAUSE   23
 #define ROBOTV_CHANNELSTREAM_SIGNAL  24
 #define ROBOTV_CHANNELSTREAM_SEEK    25
+#define ROBOTV_CHANNELSTREAM_CREDIT  26
+#define ROBOTV_CHANNELSTREAM_SELECT  27
+#define ROBOTV_CHANNELSTREAM_PREVIEW 28
 
 /* OPCODE 40 - 59: RoboTV network functions for recording streaming */
 #define ROBOTV_RECSTREAM_OPEN        40
@@ -116,6 +122,7 @@
 #define ROBOTV_STREAM_SIGNALINFO   5
 #define ROBOTV_STREAM_DETACH       7
 #define ROBOTV_STREAM_POSITIONS    8
+#define ROBOTV_STREAM_PREVIEW      9
 
 /** Stream status codes */
 #define ROBOTV_STREAM_STATUS_SIGNALLOST     111
@@ -0,0 +1,67 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include "livecmds.h"
+#include "live/livereceiver.h"
+
+using json = nlohmann::json;
+
+LiveCmds::LiveCmds() {
+}
+
+LiveCmds::LiveCmds(const LiveCmds& orig) {
+}
+
+LiveCmds::~LiveCmds() {
+}
+
+cString LiveCmds::SVDRPCommand(const char* Command, const char* Option, int& ReplyCode) {
+    if(strcasecmp(Command, "LSLJ") == 0) {
+        return processListLiveJson(Option, ReplyCode);
+    }
+
+    ReplyCode = 500;
+    return NULL;
+}
+
+cString LiveCmds::processListLiveJson(const char* Option, int& ReplyCode) {
+    json list = json::array();
+
+    for(auto& status: LiveReceiver::getStatus()) {
+        list.push_back({
+            {"channelUid", status.channelUid},
+            {"clients", status.clients},
+            {"language", status.language},
+            {"readers", status.queue.readers},
+            {"timeShift", status.queue.timeShift},
+            {"memorySize", status.queue.memorySize},
+            {"bytesCompacted", status.queue.bytesCompacted},
+            {"packetsWritten", status.queue.packetsWritten},
+            {"packetsDropped", status.queue.packetsDropped},
+            {"nonReferenceDropped", status.queue.nonReferenceDropped}
+        });
+    }
+
+    return cString(list.dump().c_str());
+}
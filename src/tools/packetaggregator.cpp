@@ -0,0 +1,166 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#include <string.h>
+
+#ifdef __FreeBSD__
+#include <sys/endian.h>
+#else
+#include <endian.h>
+#endif
+
+#include "net/msgpacket.h"
+#include "robotv/robotvcommand.h"
+#include "robotvdmx/streaminfo.h"
+#include "packetaggregator.h"
+
+// smallest batch size
+#define MIN_BATCH_SIZE 1024
+
+// bitrate measurement window (90kHz clock)
+#define MEASURE_WINDOW 90000
+
+// pts jumps beyond this limit restart the measurement
+#define MEASURE_DISCONTINUITY (10 * 90000)
+
+namespace roboTV {
+
+PacketAggregator::PacketAggregator(std::chrono::milliseconds latency, uint32_t maxSize) :
+    m_latency(latency),
+    m_maxSize(maxSize),
+    m_streamChange(false) {
+    reset();
+}
+
+void PacketAggregator::reset() {
+    m_bitrate = 0;
+    m_windowStart = -1;
+    m_windowEnd = -1;
+    m_windowBytes = 0;
+    m_batchStart = -1;
+    m_streamChange = false;
+}
+
+uint32_t PacketAggregator::getThreshold() const {
+    uint64_t threshold = (m_bitrate * m_latency.count()) / 1000;
+
+    if(threshold < MIN_BATCH_SIZE) {
+        return MIN_BATCH_SIZE;
+    }
+
+    if(threshold > m_maxSize) {
+        return m_maxSize;
+    }
+
+    return (uint32_t)threshold;
+}
+
+bool PacketAggregator::add(MsgPacket* p, uint32_t batchSize) {
+    uint16_t msgid = p->getMsgID();
+
+    // new streams -> measure again and send the first keyframe immediately
+    if(msgid == ROBOTV_STREAM_CHANGE) {
+        reset();
+        m_streamChange = true;
+        return false;
+    }
+
+    if(msgid != ROBOTV_STREAM_MUXPKT) {
+        return (batchSize >= getThreshold());
+    }
+
+    int64_t pts = measure(p);
+
+    if(m_streamChange && p->getClientID() == (uint16_t)StreamInfo::FrameType::IFRAME) {
+        m_streamChange = false;
+        m_batchStart = -1;
+        return true;
+    }
+
+    bool flush = (batchSize >= getThreshold());
+
+    // bitrate not known yet -> limit the duration of the batch
+    if(m_bitrate == 0) {
+        flush = (batchSize >= m_maxSize);
+
+        if(pts >= 0 && (m_batchStart < 0 || pts < m_batchStart)) {
+            m_batchStart = pts;
+        }
+
+        if(pts >= 0) {
+            flush |= ((pts - m_batchStart) * 1000 / 90000 >= m_latency.count());
+        }
+    }
+
+    if(flush) {
+        m_batchStart = -1;
+    }
+
+    return flush;
+}
+
+int64_t PacketAggregator::measure(MsgPacket* p) {
+    // payload: pid (U16), pts (S64), ...
+    if(p->getPayloadLength() < sizeof(uint16_t) + sizeof(int64_t)) {
+        return -1;
+    }
+
+    // packets are shared, so don't touch the read position
+    uint64_t value;
+    memcpy(&value, p->getPayload() + sizeof(uint16_t), sizeof(value));
+    int64_t pts = (int64_t)be64toh(value);
+
+    if(pts < 0) {
+        return -1;
+    }
+
+    // start a new window
+    if(m_windowStart < 0 || pts < m_windowStart - MEASURE_DISCONTINUITY || pts > m_windowEnd + MEASURE_DISCONTINUITY) {
+        m_windowStart = pts;
+        m_windowEnd = pts;
+        m_windowBytes = 0;
+    }
+
+    if(pts > m_windowEnd) {
+        m_windowEnd = pts;
+    }
+
+    m_windowBytes += p->getPacketLength();
+
+    int64_t duration = m_windowEnd - m_windowStart;
+
+    if(duration < MEASURE_WINDOW) {
+        return pts;
+    }
+
+    uint64_t bitrate = (m_windowBytes * 90000) / duration;
+    m_bitrate = (m_bitrate == 0) ? bitrate : (m_bitrate * 3 + bitrate) / 4;
+
+    m_windowStart = m_windowEnd;
+    m_windowBytes = 0;
+
+    return pts;
+}
+
+} // namespace roboTV
@@ -0,0 +1,92 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_PACKETAGGREGATOR_H
+#define ROBOTV_PACKETAGGREGATOR_H
+
+#include <chrono>
+#include <stdint.h>
+
+class MsgPacket;
+
+namespace roboTV {
+
+/**
+ * Aggregation policy for stream packets.
+ * Stream packets are sent in batches to the client. The size of a batch is
+ * derived from the measured bitrate of the stream and a target latency, so
+ * low bitrate streams (e.g. radio channels) are not held back for seconds.
+ */
+class PacketAggregator {
+public:
+
+    PacketAggregator(std::chrono::milliseconds latency, uint32_t maxSize);
+
+    /**
+     * Account a stream packet added to the current batch.
+     * @param p stream packet
+     * @param batchSize size of the batch (including the packet)
+     * @return true if the batch should be sent
+     */
+    bool add(MsgPacket* p, uint32_t batchSize);
+
+    /**
+     * Restart bitrate measurement (e.g. after a seek).
+     */
+    void reset();
+
+    uint32_t getThreshold() const;
+
+    uint64_t getBitrate() const {
+        return m_bitrate;
+    }
+
+private:
+
+    int64_t measure(MsgPacket* p);
+
+    std::chrono::milliseconds m_latency;
+
+    uint32_t m_maxSize;
+
+    // bytes per second
+    uint64_t m_bitrate;
+
+    // measurement window
+    int64_t m_windowStart;
+
+    int64_t m_windowEnd;
+
+    uint64_t m_windowBytes;
+
+    // pts of the first packet in the batch
+    int64_t m_batchStart;
+
+    // flush with the next keyframe
+    bool m_streamChange;
+};
+
+} // namespace roboTV
+
+#endif // ROBOTV_PACKETAGGREGATOR_H
@@ -0,0 +1,111 @@
+/*
+ *      vdr-plugin-robotv - roboTV server plugin for VDR
+ *
+ *      Copyright (C) 2016 Alexander Pipelka
+ *
+ *      https://github.com/pipelka/vdr-plugin-robotv
+ *
+ *  This Program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2, or (at your option)
+ *  any later version.
+ *
+ *  This Program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  the Free Software Foundation, 675 Mass Ave, Cambridge, MA 02139, USA.
+ *  http://www.gnu.org/copyleft/gpl.html
+ *
+ */
+
+#ifndef ROBOTV_SPSCQUEUE_H
+#define ROBOTV_SPSCQUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+
+namespace roboTV {
+
+/**
+ * Bounded lock-free single-producer / single-consumer queue.
+ * push() must only be called from one thread, pop() only from another one.
+ * @tparam T item type
+ * @tparam N number of slots (must be a power of two)
+ */
+template<class T, size_t N>
+class SpscQueue {
+    static_assert((N & (N - 1)) == 0, "queue size must be a power of two");
+public:
+
+    SpscQueue() : m_head(0), m_tail(0) {
+    }
+
+    /**
+     * Add an item to the queue (producer).
+     * @param item the item to add
+     * @return false if the queue is full
+     */
+    bool push(const T& item) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+
+        if(tail - m_head.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+
+        m_items[tail & (N - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * Remove an item from the queue (consumer).
+     * @param item receives the removed item
+     * @return false if the queue is empty
+     */
+    bool pop(T& item) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+
+        if(head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        // release the slot content
+        item = m_items[head & (N - 1)];
+        m_items[head & (N - 1)] = T();
+
+        m_head.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    size_t size() const {
+        size_t head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static constexpr size_t capacity() {
+        return N;
+    }
+
+private:
+
+    T m_items[N];
+
+    std::atomic<size_t> m_head;
+
+    std::atomic<size_t> m_tail;
+
+};
+
+} // namespace roboTV
+
+#endif // ROBOTV_SPSCQUEUE_H